@@ -48,6 +48,7 @@ LOCAL_SRC_FILES := \
 	src/gl/line.c \
 	src/gl/list.c \
 	src/gl/listdraw.c \
+	src/gl/listopt.c \
 	src/gl/listrl.c \
 	src/gl/loader.c \
 	src/gl/logs.c \
@@ -33,6 +33,8 @@
 #define GL_AVOID16BITS_HINT_GL4ES	    0xA10E
 // same as using LIBGL_GAMMA=xx (PANDORA only)
 #define GL_GAMMA_HINT_GL4ES             0xA10F
+// same as using LIBGL_FPELIGHTING=x
+#define GL_FPELIGHTING_HINT_GL4ES       0xA110
 
 // special value to query underlying Hardware value using glGetString
 #define GL_VENDOR_GL4ES                 (GL_VENDOR | 0x10000)
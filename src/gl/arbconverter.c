@@ -10,7 +10,7 @@
 #define FAIL(str) curStatus.status = ST_ERROR; if (*error_msg) free(*error_msg); \
 		*error_msg = strdup(str); continue
 #define curStatusPtr &curStatus
-char* gl4es_convertARB(const char* const code, int vertex, char **error_msg, int *error_ptr) {
+static char* convertARB_internal(const char* const code, int vertex, char **error_msg, int *error_ptr) {
 	*error_ptr = -1; // Reinit error pointer
 	
 	struct sSpecialCases specialCases = {0, 0};
@@ -350,3 +350,63 @@ char* gl4es_convertARB(const char* const code, int vertex, char **error_msg, int
 	freeStatus(&curStatus);
 	return curStatus.outputString;
 }
+
+// Successful conversions, as old engines tend to send the same programs again and again
+typedef struct arbcache_s {
+	char *code;
+	int vertex;
+	char *glsl;
+} arbcache_t;
+
+KHASH_MAP_INIT_INT64(arbcache, arbcache_t*)
+static kh_arbcache_t *arbcache = NULL;
+#define MAX_ARBCACHE 256
+
+static uint64_t hash_arb(const char* s, int vertex) {
+	// FNV-1a
+	uint64_t h = 14695981039346656037ULL ^ (vertex ? 1 : 0);
+	while (*s)
+		h = (h ^ (unsigned char)*(s++)) * 1099511628211ULL;
+	return h;
+}
+
+char* gl4es_convertARB(const char* const code, int vertex, char **error_msg, int *error_ptr) {
+	if (!arbcache)
+		arbcache = kh_init(arbcache);
+	uint64_t key = hash_arb(code, vertex);
+	khint_t k = kh_get(arbcache, arbcache, key);
+	if (k != kh_end(arbcache)) {
+		arbcache_t *c = kh_value(arbcache, k);
+		if ((c->vertex == vertex) && !strcmp(c->code, code)) {
+			*error_ptr = -1;
+			return strdup(c->glsl);
+		}
+	}
+	char *ret = convertARB_internal(code, vertex, error_msg, error_ptr);
+	if (!ret || (*error_ptr != -1))
+		return ret;
+	if (kh_size(arbcache) >= MAX_ARBCACHE) {
+		// simple flush, the working set is usually much smaller
+		arbcache_t *c;
+		kh_foreach_value(arbcache, c,
+			free(c->code);
+			free(c->glsl);
+			free(c);
+		);
+		kh_clear(arbcache, arbcache);
+	}
+	arbcache_t *c = (arbcache_t*)malloc(sizeof(arbcache_t));
+	c->code = strdup(code);
+	c->vertex = vertex;
+	c->glsl = strdup(ret);
+	int r;
+	k = kh_put(arbcache, arbcache, key, &r);
+	if (!r) {
+		arbcache_t *old = kh_value(arbcache, k);
+		free(old->code);
+		free(old->glsl);
+		free(old);
+	}
+	kh_value(arbcache, k) = c;
+	return ret;
+}
@@ -2,10 +2,17 @@
 
 #include "debug.h"
 #include "enum_info.h"
+#include "gl4es.h"
 #include "glcase.h"
 #include "light.h"
 #include "state.h"
 
+#if defined(__ARM_NEON__) && !defined(__APPLE__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 GLvoid *copy_gl_array(const GLvoid *src,
                       GLenum from, GLsizei width, GLsizei stride,
                       GLenum to, GLsizei to_width, GLsizei skip, GLsizei count, void* dst) {
@@ -424,13 +431,53 @@ GLfloat *copy_eval_float2(GLenum target, GLint ustride, GLint uorder,
 
 void getminmax_indices_us(const GLushort *indices, GLsizei *max, GLsizei *min, GLsizei count) {
     if (!count) return;
-    *max = indices[0];
-    *min = indices[0];
-    for (int i = 1; i < count; i++) {
-        GLsizei n = indices[i];
-        if( n < *min) *min = n;
-        if (n > *max) *max = n;
+    GLushort mi = indices[0], ma = indices[0];
+    int i = 1;
+#if defined(__ARM_NEON__) && !defined(__APPLE__)
+    if (count>=16) {
+        uint16x8_t vmin = vld1q_u16(indices);
+        uint16x8_t vmax = vmin;
+        for (i = 8; i+8 <= count; i+=8) {
+            uint16x8_t v = vld1q_u16(indices+i);
+            vmin = vminq_u16(vmin, v);
+            vmax = vmaxq_u16(vmax, v);
+        }
+        uint16x4_t m = vpmin_u16(vget_low_u16(vmin), vget_high_u16(vmin));
+        m = vpmin_u16(m, m);
+        m = vpmin_u16(m, m);
+        mi = vget_lane_u16(m, 0);
+        m = vpmax_u16(vget_low_u16(vmax), vget_high_u16(vmax));
+        m = vpmax_u16(m, m);
+        m = vpmax_u16(m, m);
+        ma = vget_lane_u16(m, 0);
+    }
+#elif defined(__SSE2__)
+    if (count>=16) {
+        // no unsigned 16bits min/max in SSE2, so bias to signed
+        const __m128i bias = _mm_set1_epi16((short)0x8000);
+        __m128i vmin = _mm_xor_si128(_mm_loadu_si128((const __m128i*)indices), bias);
+        __m128i vmax = vmin;
+        for (i = 8; i+8 <= count; i+=8) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(indices+i)), bias);
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+        }
+        GLushort tmin[8], tmax[8];
+        _mm_storeu_si128((__m128i*)tmin, _mm_xor_si128(vmin, bias));
+        _mm_storeu_si128((__m128i*)tmax, _mm_xor_si128(vmax, bias));
+        for (int j = 0; j < 8; j++) {
+            if (tmin[j] < mi) mi = tmin[j];
+            if (tmax[j] > ma) ma = tmax[j];
+        }
     }
+#endif
+    for (; i < count; i++) {
+        GLushort n = indices[i];
+        if (n < mi) mi = n;
+        if (n > ma) ma = n;
+    }
+    *max = ma;
+    *min = mi;
 }
 void normalize_indices_us(GLushort *indices, GLsizei *max, GLsizei *min, GLsizei count) {
     getminmax_indices_us(indices, max, min, count);
@@ -441,13 +488,53 @@ void normalize_indices_us(GLushort *indices, GLsizei *max, GLsizei *min, GLsizei
 
 void getminmax_indices_ui(const GLuint *indices, GLsizei *max, GLsizei *min, GLsizei count) {
     if (!count) return;
-    *max = indices[0];
-    *min = indices[0];
-    for (int i = 1; i < count; i++) {
-        GLsizei n = indices[i];
-        if( n < *min) *min = n;
-        if (n > *max) *max = n;
+    GLuint mi = indices[0], ma = indices[0];
+    int i = 1;
+#if defined(__ARM_NEON__) && !defined(__APPLE__)
+    if (count>=8) {
+        uint32x4_t vmin = vld1q_u32(indices);
+        uint32x4_t vmax = vmin;
+        for (i = 4; i+4 <= count; i+=4) {
+            uint32x4_t v = vld1q_u32(indices+i);
+            vmin = vminq_u32(vmin, v);
+            vmax = vmaxq_u32(vmax, v);
+        }
+        uint32x2_t m = vpmin_u32(vget_low_u32(vmin), vget_high_u32(vmin));
+        m = vpmin_u32(m, m);
+        mi = vget_lane_u32(m, 0);
+        m = vpmax_u32(vget_low_u32(vmax), vget_high_u32(vmax));
+        m = vpmax_u32(m, m);
+        ma = vget_lane_u32(m, 0);
+    }
+#elif defined(__SSE2__)
+    if (count>=8) {
+        // no 32bits min/max in SSE2, so bias to signed and select with a compare
+        const __m128i bias = _mm_set1_epi32((int)0x80000000);
+        __m128i vmin = _mm_xor_si128(_mm_loadu_si128((const __m128i*)indices), bias);
+        __m128i vmax = vmin;
+        for (i = 4; i+4 <= count; i+=4) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(indices+i)), bias);
+            __m128i lt = _mm_cmplt_epi32(v, vmin);
+            __m128i gt = _mm_cmpgt_epi32(v, vmax);
+            vmin = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, vmin));
+            vmax = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, vmax));
+        }
+        GLuint tmin[4], tmax[4];
+        _mm_storeu_si128((__m128i*)tmin, _mm_xor_si128(vmin, bias));
+        _mm_storeu_si128((__m128i*)tmax, _mm_xor_si128(vmax, bias));
+        for (int j = 0; j < 4; j++) {
+            if (tmin[j] < mi) mi = tmin[j];
+            if (tmax[j] > ma) ma = tmax[j];
+        }
     }
+#endif
+    for (; i < count; i++) {
+        GLuint n = indices[i];
+        if (n < mi) mi = n;
+        if (n > ma) ma = n;
+    }
+    *max = ma;
+    *min = mi;
 }
 void normalize_indices_ui(GLuint *indices, GLsizei *max, GLsizei *min, GLsizei count) {
     getminmax_indices_ui(indices, max, min, count);
@@ -456,6 +543,42 @@ void normalize_indices_ui(GLuint *indices, GLsizei *max, GLsizei *min, GLsizei c
     }
 }
 
+void getminmax_indices(GLenum type, const void *indices, GLsizei *max, GLsizei *min, GLsizei count) {
+    if (!count) return;
+    glbuffer_t *buff = glstate->vao->elements;
+    indexrange_t *r = NULL;
+    if (buff && buff->data && !buff->mapped
+        && (uintptr_t)indices>=(uintptr_t)buff->data && (uintptr_t)indices<(uintptr_t)buff->data+buff->size) {
+        const uintptr_t offset = (uintptr_t)indices - (uintptr_t)buff->data;
+        for (int i = 0; i < buff->nb_range; i++) {
+            r = &buff->range[i];
+            if (r->offset==offset && r->count==count && r->type==type && r->generation==buff->generation) {
+                *max = r->max;
+                *min = r->min;
+                return;
+            }
+        }
+        if (buff->nb_range<MAX_RANGECACHE)
+            r = &buff->range[buff->nb_range++];
+        else {
+            r = &buff->range[buff->range_idx];
+            buff->range_idx = (buff->range_idx+1)%MAX_RANGECACHE;
+        }
+        r->offset = offset;
+        r->count = count;
+        r->type = type;
+        r->generation = buff->generation;
+    }
+    if (type==GL_UNSIGNED_INT)
+        getminmax_indices_ui((const GLuint*)indices, max, min, count);
+    else
+        getminmax_indices_us((const GLushort*)indices, max, min, count);
+    if (r) {
+        r->max = *max;
+        r->min = *min;
+    }
+}
+
 void *copy_gl_array_bgra(void* dest, const void *ptr, GLint stride, GLsizei width, GLsizei skip, GLsizei count) {
 	// this one only convert from BGRA (unsigned byte) to RGBA FLOAT
     GLubyte* src = (GLubyte*)ptr;
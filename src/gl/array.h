@@ -29,6 +29,8 @@ void normalize_indices_us(GLushort *indices, GLsizei *max, GLsizei *min, GLsizei
 void getminmax_indices_us(const GLushort *indices, GLsizei *max, GLsizei *min, GLsizei count);
 void normalize_indices_ui(GLuint *indices, GLsizei *max, GLsizei *min, GLsizei count);
 void getminmax_indices_ui(const GLuint *indices, GLsizei *max, GLsizei *min, GLsizei count);
+// same, for GL_UNSIGNED_SHORT or GL_UNSIGNED_INT indices, cached if they are in the bound element buffer
+void getminmax_indices(GLenum type, const void *indices, GLsizei *max, GLsizei *min, GLsizei count);
 
 GLfloat *copy_eval_double1(GLenum target, GLint ustride, GLint uorder, const GLdouble *points);
 GLfloat *copy_eval_float1(GLenum target, GLint ustride, GLint uorder, const GLfloat *points);
@@ -2,13 +2,16 @@
 
 #include "khash.h"
 #include "../glx/hardext.h"
+#include "array.h"
 #include "attributes.h"
 #include "debug.h"
+#include "enum_info.h"
 #include "gl4es.h"
 #include "glstate.h"
 #include "logs.h"
 #include "init.h"
 #include "loader.h"
+#include "pixel.h"
 
 //#define DEBUG
 #ifdef DEBUG
@@ -22,6 +25,12 @@ KHASH_MAP_IMPL_INT(buff, glbuffer_t *);
 KHASH_MAP_IMPL_INT(glvao, glvao_t*);
 
 static GLuint lastbuffer = 1;
+// number of buffers without CPU copy (so nothing to check if 0)
+static int gpuonly_count = 0;
+
+// those GLES entry points are not part of the wrapper
+typedef void* (APIENTRY_GLES * glMapBufferRange_PTR)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean (APIENTRY_GLES * glUnmapBuffer_PTR)(GLenum target);
 
 // Utility function to bind / unbind a particular buffer
 
@@ -94,6 +103,521 @@ void rebind_real_buff_arrays(int old_buffer, int new_buffer) {
     }
 }
 
+// read access to a real buffer, with GLES 3.0 or GL_EXT_map_buffer_range
+static void* map_real_buffer_ext(GLenum target, GLsizeiptr size) {
+    LOAD_GLES_EXT(glMapBufferRange);
+    return gles_glMapBufferRange(target, 0, size, GL_MAP_READ_BIT_EXT);
+}
+static void unmap_real_buffer_oes(GLenum target) {
+    LOAD_GLES_OES(glUnmapBuffer);
+    gles_glUnmapBuffer(target);
+}
+static void* map_real_buffer(GLenum target, GLsizeiptr size) {
+    if(hardext.gles3) {
+        LOAD_GLES2(glMapBufferRange);
+        if(gles_glMapBufferRange)
+            return gles_glMapBufferRange(target, 0, size, GL_MAP_READ_BIT);
+    }
+    return map_real_buffer_ext(target, size);
+}
+static void unmap_real_buffer(GLenum target) {
+    if(hardext.gles3) {
+        LOAD_GLES2(glUnmapBuffer);
+        if(gles_glUnmapBuffer) {
+            gles_glUnmapBuffer(target);
+            return;
+        }
+    }
+    unmap_real_buffer_oes(target);
+}
+
+// legacy pointers (glVertexPointer & co) have the CPU address of the buffer included
+static void rebase_vao_arrays(glvao_t *vao, glbuffer_t *buff, void* olddata, void* newdata) {
+    for (int j = 0; j < hardext.maxvattrib; j++) {
+        vertexattrib_t *v = &vao->vertexattrib[j];
+        if (v->real_buffer == buff->real_buffer && v->buffer != buff
+            && v->pointer == (void*)((uintptr_t)olddata + (uintptr_t)v->real_pointer))
+            v->pointer = (void*)((uintptr_t)newdata + (uintptr_t)v->real_pointer);
+    }
+}
+static void rebase_arrays(glbuffer_t *buff, void* olddata, void* newdata) {
+    glvao_t *vao;
+    rebase_vao_arrays(glstate->defaultvao, buff, olddata, newdata);
+    kh_foreach_value(glstate->vaos, vao,
+        rebase_vao_arrays(vao, buff, olddata, newdata);
+    )
+}
+
+static void extend_range(GLintptr *rstart, GLintptr *rend, GLintptr start, GLintptr end) {
+    if(*rstart>=*rend) {
+        *rstart = start;
+        *rend = end;
+    } else {
+        if(start<*rstart) *rstart = start;
+        if(end>*rend) *rend = end;
+    }
+}
+
+// data may have changed between start and end
+static void changed_range(glbuffer_t *buff, GLintptr start, GLintptr end) {
+    ++buff->generation;
+    if(start>=end)
+        return;
+    extend_range(&buff->upbo_start, &buff->upbo_end, start, end);
+    for (int i=0; i<buff->nb_conv; ++i)
+        extend_range(&buff->conv[i].dirty_start, &buff->conv[i].dirty_end, start, end);
+}
+
+// range of a mapped buffer that can be written by the application (0 if read only)
+static int mapped_write_range(glbuffer_t *buff, GLintptr *start, GLintptr *end) {
+    if(!buff->mapped)
+        return 0;
+    if(buff->ranged) {
+        if(!(buff->access&GL_MAP_WRITE_BIT_EXT))
+            return 0;
+        *start = buff->offset;
+        *end = buff->offset+buff->length;
+    } else {
+        if(buff->access!=GL_WRITE_ONLY && buff->access!=GL_READ_WRITE)
+            return 0;
+        *start = 0;
+        *end = buff->size;
+    }
+    return 1;
+}
+
+// CPU copy of the buffer, skipped if the datas can live only in the real VBO
+static void update_shadow(glbuffer_t *buff, GLsizeiptr size, const GLvoid * data, int gpuonly) {
+    if(gpuonly) {
+        if(buff->data) {
+            rebase_arrays(buff, buff->data, NULL);
+            free(buff->data);
+            buff->data = NULL;
+        }
+        if(!buff->gpuonly)
+            ++gpuonly_count;
+        buff->gpuonly = 1;
+        DBG(printf("\t buff->data not needed (size=%zd)\n", size);)
+        return;
+    }
+    if(buff->gpuonly) {
+        --gpuonly_count;
+        buff->gpuonly = 0;
+    }
+    if (buff->data && buff->size<size) {
+        free(buff->data);
+        buff->data = NULL;
+    }
+    if(!buff->data)
+        buff->data = malloc(size);
+    DBG(printf("\t buff->data = %p (size=%zd)\n", buff->data, size);)
+    if (data)
+        memcpy(buff->data, data, size);
+}
+
+void realize_buffer_shadow(glbuffer_t *buff) {
+    if(!buff || !buff->gpuonly)
+        return;
+    DBG(printf("realize_buffer_shadow(%u), size=%zd\n", buff->buffer, buff->size);)
+    buff->data = malloc(buff->size);
+    bindBuffer(GL_ARRAY_BUFFER, buff->real_buffer);
+    void* p = map_real_buffer(GL_ARRAY_BUFFER, buff->size);
+    if(p) {
+        memcpy(buff->data, p, buff->size);
+        unmap_real_buffer(GL_ARRAY_BUFFER);
+    } else {
+        LOGE("Warning, cannot read back content of buffer %u\n", buff->buffer);
+        memset(buff->data, 0, buff->size);
+    }
+    buff->gpuonly = 0;
+    buff->keepshadow = 1;
+    --gpuonly_count;
+    rebase_arrays(buff, NULL, buff->data);
+}
+
+// is the buffer used by the vao for something else than packing (so its content can be read by a draw or a texture upload)?
+static int vao_uses_buffer(glvao_t *vao, glbuffer_t *buff) {
+    if(vao->vertex==buff || vao->elements==buff || vao->unpack==buff)
+        return 1;
+    for (int i=0; i<hardext.maxvattrib; i++)
+        if(vao->vertexattrib[i].buffer==buff)
+            return 1;
+    return 0;
+}
+
+// a vao is made current: the pending reads of the buffers it uses must be done
+static void realize_vao_pack_buffers(glvao_t *vao) {
+    realize_pack_buffer(vao->vertex);
+    realize_pack_buffer(vao->elements);
+    realize_pack_buffer(vao->unpack);
+    for (int i=0; i<hardext.maxvattrib; i++)
+        realize_pack_buffer(vao->vertexattrib[i].buffer);
+}
+
+void readpixels_to_pbo(glbuffer_t *buff, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLenum dstformat, GLenum dsttype, GLintptr offset) {
+    LOAD_GLES(glReadPixels);
+    LOAD_GLES(glBindBuffer);
+    LOAD_GLES(glGenBuffers);
+    LOAD_GLES(glBufferData);
+    DBG(printf("readpixels_to_pbo(%u, %d, %d, %d, %d, %s, %s, %s, %s, %p)\n", buff->buffer, x, y, width, height, PrintEnum(format), PrintEnum(type), PrintEnum(dstformat), PrintEnum(dsttype), (void*)offset);)
+    realize_pack_buffer(buff);  // only 1 pending read per buffer
+    // GLES use the same GL_PACK_ALIGNMENT
+    GLsizeiptr size = widthalign(width*pixel_sizeof(format, type), glstate->texture.pack_align)*height;
+    if(!buff->pbo)
+        gles_glGenBuffers(1, &buff->pbo);
+    gles_glBindBuffer(GL_PIXEL_PACK_BUFFER, buff->pbo);
+    if(buff->pbo_size<size) {
+        gles_glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        buff->pbo_size = size;
+    }
+    gles_glReadPixels(x, y, width, height, format, type, NULL);
+    gles_glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    buff->pbo_pending = 1;
+    buff->pbo_offset = offset;
+    buff->pbo_width = width;
+    buff->pbo_height = height;
+    buff->pbo_format = format;
+    buff->pbo_type = type;
+    buff->pbo_dstformat = dstformat;
+    buff->pbo_dsttype = dsttype;
+    buff->pbo_align = glstate->texture.pack_align;
+    // already bound for drawing or unpacking: it will not go through a bind again, so no async read
+    if(vao_uses_buffer(glstate->vao, buff))
+        realize_pack_buffer(buff);
+}
+
+void realize_pack_buffer(glbuffer_t *buff) {
+    if(!buff || !buff->pbo_pending)
+        return;
+    LOAD_GLES(glBindBuffer);
+    DBG(printf("realize_pack_buffer(%u)\n", buff->buffer);)
+    buff->pbo_pending = 0;
+    GLsizeiptr size = widthalign(buff->pbo_width*pixel_sizeof(buff->pbo_format, buff->pbo_type), buff->pbo_align)*buff->pbo_height;
+    gles_glBindBuffer(GL_PIXEL_PACK_BUFFER, buff->pbo);
+    void* p = map_real_buffer(GL_PIXEL_PACK_BUFFER, size);
+    if(!p) {
+        LOGE("Warning, cannot map PBO of buffer %u\n", buff->buffer);
+    } else {
+        GLvoid *dst = (char*)buff->data + buff->pbo_offset;
+        if(buff->pbo_format==buff->pbo_dstformat && buff->pbo_type==buff->pbo_dsttype) {
+            if(size>buff->size-buff->pbo_offset)
+                size = buff->size-buff->pbo_offset;
+            memcpy(dst, p, size);
+        } else if (!pixel_convert(p, &dst, buff->pbo_width, buff->pbo_height, buff->pbo_format, buff->pbo_type,
+                buff->pbo_dstformat, buff->pbo_dsttype, 0, buff->pbo_align)) {
+            LOGE("ReadPixels error: (%s, %s -> %s, %s )\n",
+                PrintEnum(buff->pbo_format), PrintEnum(buff->pbo_type), PrintEnum(buff->pbo_dstformat), PrintEnum(buff->pbo_dsttype));
+        }
+        unmap_real_buffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gles_glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    GLsizeiptr written = widthalign(buff->pbo_width*pixel_sizeof(buff->pbo_dstformat, buff->pbo_dsttype), buff->pbo_align)*buff->pbo_height;
+    changed_range(buff, buff->pbo_offset, (buff->pbo_offset+written>buff->size)?buff->size:(buff->pbo_offset+written));
+}
+
+void bind_unpack_pbo(glbuffer_t *buff) {
+    LOAD_GLES(glBindBuffer);
+    if(!buff) {
+        gles_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+    LOAD_GLES(glGenBuffers);
+    LOAD_GLES(glBufferData);
+    LOAD_GLES(glBufferSubData);
+    realize_pack_buffer(buff);
+    if(!buff->upbo)
+        gles_glGenBuffers(1, &buff->upbo);
+    gles_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buff->upbo);
+    if(buff->upbo_size!=buff->size) {
+        DBG(printf("bind_unpack_pbo(%u) uploading %zd bytes\n", buff->buffer, buff->size);)
+        gles_glBufferData(GL_PIXEL_UNPACK_BUFFER, buff->size, buff->data, GL_STREAM_DRAW);
+        buff->upbo_size = buff->size;
+    } else {
+        GLintptr start = buff->upbo_start, end = buff->upbo_end;
+        // a mapped buffer can be written at any time
+        GLintptr mstart, mend;
+        if(mapped_write_range(buff, &mstart, &mend)) {
+            if(start>=end || mstart<start) start = mstart;
+            if(mend>end) end = mend;
+        }
+        if(start<end) {
+            DBG(printf("bind_unpack_pbo(%u) uploading %zd bytes at %zd\n", buff->buffer, end-start, start);)
+            gles_glBufferSubData(GL_PIXEL_UNPACK_BUFFER, start, end-start, (char*)buff->data+start);
+        }
+    }
+    buff->upbo_start = buff->upbo_end = 0;
+}
+
+GLuint converted_attrib(vertexattrib_t *v) {
+    glbuffer_t *buff = v->buffer;
+    // only for buffers that are not changed all the time
+    if(!buff || !buff->data || buff->mapped || buff->usage==GL_STREAM_DRAW)
+        return 0;
+    const int size = (v->size==GL_BGRA)?4:v->size;
+    const int elsize = (v->size==GL_BGRA)?4:(v->size*gl_sizeof(v->type));
+    const int stride = v->stride?v->stride:elsize;
+    const uintptr_t offset = (uintptr_t)v->pointer;
+    if(offset+elsize > buff->size)
+        return 0;
+    // all the vertices of the buffer are converted, so any draw can use it
+    const int count = (buff->size - offset - elsize)/stride + 1;
+    const void* ptr = (char*)buff->data + offset;
+    convattrib_t *c = NULL;
+    for (int i=0; i<buff->nb_conv && !c; ++i)
+        if(buff->conv[i].offset==offset && buff->conv[i].size==v->size && buff->conv[i].type==v->type && buff->conv[i].stride==stride)
+            c = &buff->conv[i];
+    if(c && c->count==count) {
+        if(c->dirty_start>=c->dirty_end)
+            return c->real_buffer;
+        // convert again only the vertices in the changed range
+        GLsizei first = ((uintptr_t)c->dirty_start>offset)?(c->dirty_start-offset)/stride:0;
+        GLsizei last = ((uintptr_t)c->dirty_end>offset)?(c->dirty_end-1-offset)/stride+1:0;
+        if(last>count) last = count;
+        c->dirty_start = c->dirty_end = 0;
+        if(first>=last)
+            return c->real_buffer;
+        GLvoid *tmp = (v->size==GL_BGRA)?copy_gl_pointer_color_bgra(ptr, stride, 4, first, last)
+                        :copy_gl_array(ptr, v->type, size, stride, GL_FLOAT, size, first, last, NULL);
+        if(!tmp)
+            return 0;
+        DBG(printf("converted_attrib(%u) offset=%zu, %s, size=%d, stride=%d => vertices %d-%d\n", buff->buffer, offset, PrintEnum(v->type), v->size, stride, first, last);)
+        LOAD_GLES(glBufferSubData);
+        bindBuffer(GL_ARRAY_BUFFER, c->real_buffer);
+        gles_glBufferSubData(GL_ARRAY_BUFFER, first*size*sizeof(GLfloat), (last-first)*size*sizeof(GLfloat), tmp);
+        free(tmp);
+        return c->real_buffer;
+    }
+    if(!c) {
+        // take a new slot, or an outdated one, or the first one
+        if(buff->nb_conv<MAX_CONVCACHE) {
+            c = &buff->conv[buff->nb_conv++];
+            c->real_buffer = 0;
+            c->count = 0;
+        } else {
+            c = &buff->conv[0];
+            for (int i=0; i<buff->nb_conv; ++i)
+                if(buff->conv[i].dirty_start<buff->conv[i].dirty_end) {
+                    c = &buff->conv[i];
+                    break;
+                }
+        }
+    }
+    GLvoid *tmp = (v->size==GL_BGRA)?copy_gl_pointer_color_bgra(ptr, stride, 4, 0, count)
+                    :copy_gl_array(ptr, v->type, size, stride, GL_FLOAT, size, 0, count, NULL);
+    if(!tmp)
+        return 0;
+    DBG(printf("converted_attrib(%u) offset=%zu, %s, size=%d, stride=%d => %d vertices\n", buff->buffer, offset, PrintEnum(v->type), v->size, stride, count);)
+    LOAD_GLES(glGenBuffers);
+    LOAD_GLES(glBufferData);
+    if(!c->real_buffer)
+        gles_glGenBuffers(1, &c->real_buffer);
+    bindBuffer(GL_ARRAY_BUFFER, c->real_buffer);
+    gles_glBufferData(GL_ARRAY_BUFFER, count*size*sizeof(GLfloat), tmp, GL_STATIC_DRAW);
+    free(tmp);
+    c->offset = offset;
+    c->size = v->size;
+    c->type = v->type;
+    c->stride = stride;
+    c->count = count;
+    c->dirty_start = c->dirty_end = 0;
+    return c->real_buffer;
+}
+
+void realize_attrib_shadow(vertexattrib_t *v) {
+    if(!gpuonly_count || !v->real_buffer)
+        return;
+    if(v->buffer && v->buffer->real_buffer==v->real_buffer) {
+        realize_buffer_shadow(v->buffer);
+        return;
+    }
+    // legacy pointer, the buffer is not referenced
+    glbuffer_t *buff;
+    kh_foreach_value(glstate->buffers, buff,
+        if(buff->gpuonly && buff->real_buffer==v->real_buffer) {
+            realize_buffer_shadow(buff);
+            return;
+        }
+    )
+}
+
+void realize_arrays_shadow(glvao_t *vao) {
+    if(!gpuonly_count)
+        return;
+    for (int i = 0; i < hardext.maxvattrib; i++)
+        if(vao->vertexattrib[i].enabled)
+            realize_attrib_shadow(&vao->vertexattrib[i]);
+}
+
+// Streaming buffers: a full update goes in the next real buffer of a ring, so the GPU can still use the previous one
+static void rebind_all_real_buff_arrays(GLuint old_buffer, GLuint new_buffer) {
+    glvao_t *vao;
+    for (int j = 0; j < hardext.maxvattrib; j++)
+        if (glstate->defaultvao->vertexattrib[j].real_buffer == old_buffer)
+            glstate->defaultvao->vertexattrib[j].real_buffer = new_buffer;
+    kh_foreach_value(glstate->vaos, vao,
+        for (int j = 0; j < hardext.maxvattrib; j++)
+            if (vao->vertexattrib[j].real_buffer == old_buffer)
+                vao->vertexattrib[j].real_buffer = new_buffer;
+    )
+}
+
+static int rotate_ring(glbuffer_t *buff, GLenum usage) {
+    if(!globals4es.vboring || !buff->real_buffer || !(usage==GL_STREAM_DRAW || usage==GL_DYNAMIC_DRAW))
+        return 0;
+    int n = (globals4es.vboring>MAX_RING)?MAX_RING:globals4es.vboring;
+    if(!buff->nb_ring) {
+        buff->ring[0] = buff->real_buffer;
+        buff->ring_idx = 0;
+        buff->nb_ring = 1;
+    }
+    int next = (buff->ring_idx+1)%n;
+    if(next==buff->nb_ring) {
+        LOAD_GLES(glGenBuffers);
+        gles_glGenBuffers(1, &buff->ring[next]);
+        ++buff->nb_ring;
+    }
+    GLuint old = buff->real_buffer;
+    buff->ring_idx = next;
+    buff->real_buffer = buff->ring[next];
+    DBG(printf("\t rotate ring of buffer %u: real VBO %u -> %u\n", buff->buffer, old, buff->real_buffer);)
+    rebind_all_real_buff_arrays(old, buff->real_buffer);
+    return 1;
+}
+
+static void free_ring(glbuffer_t *buff) {
+    for (int i=0; i<buff->nb_ring; ++i)
+        if(buff->ring[i]!=buff->real_buffer)
+            deleteSingleBuffer(buff->ring[i]);
+    buff->nb_ring = 0;
+    buff->ring_idx = 0;
+}
+
+// (re)allocate the real VBO, orphaning it in the ring when possible
+static void real_buffer_data(glbuffer_t *buff, GLenum target, GLsizeiptr size, const GLvoid * data, GLenum usage) {
+    if(!buff->real_buffer) {
+        LOAD_GLES(glGenBuffers);
+        gles_glGenBuffers(1, &buff->real_buffer);
+    } else
+        rotate_ring(buff, usage);
+    LOAD_GLES(glBufferData);
+    bindBuffer(target, buff->real_buffer);
+    gles_glBufferData(target, size, data, usage);
+    DBG(printf(" => real VBO %d\n", buff->real_buffer);)
+}
+
+// update the real VBO, a full update goes in the next buffer of the ring
+static void real_buffer_subdata(glbuffer_t *buff, GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid * data) {
+    if(offset==0 && size==buff->size && rotate_ring(buff, buff->usage)) {
+        LOAD_GLES(glBufferData);
+        bindBuffer(target, buff->real_buffer);
+        gles_glBufferData(target, size, data, buff->usage);
+    } else {
+        LOAD_GLES(glBufferSubData);
+        bindBuffer(target, buff->real_buffer);
+        gles_glBufferSubData(target, offset, size, data);
+    }
+}
+
+// Mapped buffers: track the modified ranges, to upload only those on unmap
+#define DIRTY_GAP       256     // ranges closer than that are merged
+#define DIFF_BLOCK      64      // granularity of the snapshot comparison
+#define DIFF_MINSIZE    1024    // smaller maps are simply uploaded
+
+static void dirty_range(glbuffer_t *buff, GLintptr start, GLintptr end) {
+    if(start>=end)
+        return;
+    int best = -1;
+    GLintptr best_gap = 0;
+    for (int i=0; i<buff->nb_dirty; ++i) {
+        GLintptr gap = (start>buff->dirty_end[i])?(start-buff->dirty_end[i]):((buff->dirty_start[i]>end)?(buff->dirty_start[i]-end):0);
+        if(best<0 || gap<best_gap) {
+            best = i;
+            best_gap = gap;
+        }
+    }
+    if(best<0 || (best_gap>DIRTY_GAP && buff->nb_dirty<MAX_DIRTY)) {
+        buff->dirty_start[buff->nb_dirty] = start;
+        buff->dirty_end[buff->nb_dirty] = end;
+        ++buff->nb_dirty;
+        return;
+    }
+    // merge with the closest one
+    if(start<buff->dirty_start[best]) buff->dirty_start[best] = start;
+    if(end>buff->dirty_end[best]) buff->dirty_end[best] = end;
+}
+
+static void diff_range(glbuffer_t *buff, GLintptr offset, GLsizeiptr length) {
+    const char *cur = (const char*)buff->data + offset;
+    const char *old = (const char*)buff->snapshot;
+    GLintptr start = -1;
+    for (GLintptr i=0; i<length; i+=DIFF_BLOCK) {
+        GLsizeiptr n = (length-i<DIFF_BLOCK)?(length-i):DIFF_BLOCK;
+        if(memcmp(cur+i, old+i, n)) {
+            if(start<0) start = i;
+        } else if(start>=0) {
+            dirty_range(buff, offset+start, offset+i);
+            start = -1;
+        }
+    }
+    if(start>=0)
+        dirty_range(buff, offset+start, offset+length);
+}
+
+static void map_snapshot(glbuffer_t *buff, GLintptr offset, GLsizeiptr length, int write) {
+    if(globals4es.mapdiff && write && buff->real_buffer && length>=DIFF_MINSIZE) {
+        buff->snapshot = malloc(length);
+        memcpy(buff->snapshot, (char*)buff->data+offset, length);
+    }
+}
+
+static void upload_dirty(glbuffer_t *buff) {
+    LOAD_GLES(glBufferSubData);
+    if(buff->nb_dirty==1 && buff->dirty_start[0]==0 && buff->dirty_end[0]==buff->size && rotate_ring(buff, buff->usage)) {
+        LOAD_GLES(glBufferData);
+        bindBuffer(buff->type, buff->real_buffer);
+        gles_glBufferData(buff->type, buff->size, buff->data, buff->usage);
+        buff->nb_dirty = 0;
+        return;
+    }
+    if(buff->nb_dirty)
+        bindBuffer(buff->type, buff->real_buffer);
+    for (int i=0; i<buff->nb_dirty; ++i) {
+        DBG(printf("\t upload dirty range %zd-%zd\n", buff->dirty_start[i], buff->dirty_end[i]);)
+        gles_glBufferSubData(buff->type, buff->dirty_start[i], buff->dirty_end[i]-buff->dirty_start[i], (char*)buff->data+buff->dirty_start[i]);
+    }
+    buff->nb_dirty = 0;
+}
+
+static GLboolean unmap_buffer(glbuffer_t *buff) {
+    if(buff->real_buffer && (buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) && buff->mapped) {
+        GLintptr offset = 0;
+        GLsizeiptr length = 0;
+        if(!buff->ranged && (buff->access==GL_WRITE_ONLY || buff->access==GL_READ_WRITE))
+            length = buff->size;
+        if(buff->ranged && (buff->access&GL_MAP_WRITE_BIT_EXT) && !(buff->access&GL_MAP_FLUSH_EXPLICIT_BIT_EXT)) {
+            offset = buff->offset;
+            length = buff->length;
+        }
+        if(buff->snapshot)
+            diff_range(buff, offset, length);
+        else
+            dirty_range(buff, offset, offset+length);
+        upload_dirty(buff);
+    }
+    free(buff->snapshot);
+    buff->snapshot = NULL;
+    buff->nb_dirty = 0;
+    GLintptr start = 0, end = 0;
+    mapped_write_range(buff, &start, &end);
+    changed_range(buff, start, end);
+    if (buff->mapped) {
+        buff->mapped = 0;
+        buff->ranged = 0;
+        return GL_TRUE;
+    }
+    return GL_FALSE;
+}
+
 void APIENTRY_GL4ES gl4es_glGenBuffers(GLsizei n, GLuint * buffers) {
     DBG(printf("glGenBuffers(%i, %p)\n", n, buffers);)
 	noerrorShim();
@@ -119,6 +643,22 @@ void APIENTRY_GL4ES gl4es_glGenBuffers(GLsizei n, GLuint * buffers) {
         buff->access = GL_READ_WRITE;
         buff->mapped = 0;
         buff->real_buffer = 0;
+        buff->gpuonly = 0;
+        buff->keepshadow = 0;
+        buff->nb_dirty = 0;
+        buff->snapshot = NULL;
+        buff->nb_ring = 0;
+        buff->ring_idx = 0;
+        buff->pbo = 0;
+        buff->pbo_size = 0;
+        buff->pbo_pending = 0;
+        buff->generation = 0;
+        buff->upbo = 0;
+        buff->upbo_size = 0;
+        buff->upbo_start = buff->upbo_end = 0;
+        buff->nb_conv = 0;
+        buff->nb_range = 0;
+        buff->range_idx = 0;
     }
 }
 
@@ -154,15 +694,43 @@ void APIENTRY_GL4ES gl4es_glBindBuffer(GLenum target, GLuint buffer) {
             buff->access = GL_READ_WRITE;
             buff->mapped = 0;
             buff->real_buffer = 0;
+            buff->gpuonly = 0;
+            buff->keepshadow = 0;
+            buff->nb_dirty = 0;
+            buff->snapshot = NULL;
+            buff->nb_ring = 0;
+            buff->ring_idx = 0;
+            buff->pbo = 0;
+            buff->pbo_size = 0;
+            buff->pbo_pending = 0;
+            buff->generation = 0;
+            buff->upbo = 0;
+            buff->upbo_size = 0;
+            buff->upbo_start = buff->upbo_end = 0;
+            buff->nb_conv = 0;
+            buff->nb_range = 0;
+            buff->range_idx = 0;
         } else {
             buff = kh_value(list, k);
             buff->type = target;    //TODO: check if old binding?
+            if(target!=GL_ARRAY_BUFFER)
+                realize_buffer_shadow(buff);    // will be read on the CPU side
+            if(target!=GL_PIXEL_PACK_BUFFER)
+                realize_pack_buffer(buff);
+            else
+                changed_range(buff, 0, buff->size);   // may be written by a glReadPixels
         }
         bind_buffer(target, buff);
     }
     noerrorShim();
 }
 
+// can the buffer datas live only in the real VBO? (they can be read back if needed)
+static int can_gpuonly(glbuffer_t *buff, GLenum target, GLenum usage) {
+    return globals4es.novboshadow && target==GL_ARRAY_BUFFER && (usage==GL_STATIC_DRAW || usage==GL_DYNAMIC_DRAW)
+        && !buff->keepshadow && (hardext.gles3 || (hardext.mapbuffer && hardext.mapbufferrange));
+}
+
 void APIENTRY_GL4ES gl4es_glBufferData(GLenum target, GLsizeiptr size, const GLvoid * data, GLenum usage) {
     DBG(printf("glBufferData(%s, %zi, %p, %s)\n", PrintEnum(target), size, data, PrintEnum(usage));)
 	if (!buffer_target(target)) {
@@ -185,35 +753,21 @@ void APIENTRY_GL4ES gl4es_glBufferData(GLenum target, GLsizeiptr size, const GLv
     
     if(buff->real_buffer && !go_real) {
         rebind_real_buff_arrays(buff->real_buffer, 0);
+        free_ring(buff);
         
         deleteSingleBuffer(buff->real_buffer);
         // what about VA already pointing there?
         buff->real_buffer = 0;
     }
-    if(go_real) {
-        if(!buff->real_buffer) {
-            LOAD_GLES(glGenBuffers);
-            gles_glGenBuffers(1, &buff->real_buffer);
-        }
-        LOAD_GLES(glBufferData);
-        LOAD_GLES(glBindBuffer);
-        bindBuffer(target, buff->real_buffer);
-        gles_glBufferData(target, size, data, usage);
-        DBG(printf(" => real VBO %d\n", buff->real_buffer);)
-    }
-        
-    if (buff->data && buff->size<size) {
-        free(buff->data);
-        buff->data = NULL;
-    }
-    if(!buff->data)
-        buff->data = malloc(size);
+    if(go_real)
+        real_buffer_data(buff, target, size, data, usage);
+
+    buff->pbo_pending = 0;  // content is replaced anyway
+    changed_range(buff, 0, size);
+    update_shadow(buff, size, data, go_real && can_gpuonly(buff, target, usage));
     buff->size = size;
     buff->usage = usage;
-    DBG(printf("\t buff->data = %p (size=%zd)\n", buff->data, size);)
     buff->access = GL_READ_WRITE;
-    if (data)
-        memcpy(buff->data, data, size);
     // update binded VA
     for (int i=0; i<hardext.maxvattrib; ++i) {
         vertexattrib_t *v = &glstate->vao->vertexattrib[i];
@@ -233,37 +787,26 @@ void APIENTRY_GL4ES gl4es_glNamedBufferData(GLuint buffer, GLsizeiptr size, cons
 		errorShim(GL_INVALID_OPERATION);
         return;
     }
-    if (buff->data) {
-        free(buff->data);
-
-    }
     int go_real = 0;
     if(     (buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) 
          && (usage==GL_STREAM_DRAW || usage==GL_STATIC_DRAW || usage==GL_DYNAMIC_DRAW) && globals4es.usevbo)
         go_real = 1;
     
     if(buff->real_buffer && !go_real) {
+        free_ring(buff);
         deleteSingleBuffer(buff->real_buffer);
         // what about VA already pointing there?
         buff->real_buffer = 0;
     }
-    if(go_real) {
-        if(!buff->real_buffer) {
-            LOAD_GLES(glGenBuffers);
-            gles_glGenBuffers(1, &buff->real_buffer);
-        }
-        LOAD_GLES(glBufferData);
-        LOAD_GLES(glBindBuffer);
-        bindBuffer(buff->type, buff->real_buffer);
-        gles_glBufferData(buff->type, size, data, usage);
-    }
+    if(go_real)
+        real_buffer_data(buff, buff->type, size, data, usage);
 
+    buff->pbo_pending = 0;
+    changed_range(buff, 0, size);
+    update_shadow(buff, size, data, go_real && can_gpuonly(buff, buff->type, usage));
     buff->size = size;
     buff->usage = usage;
-    buff->data = malloc(size);
     buff->access = GL_READ_WRITE;
-    if (data)
-        memcpy(buff->data, data, size);
     // update binded VA
     for (int i=0; i<hardext.maxvattrib; ++i) {
         vertexattrib_t *v = &glstate->vao->vertexattrib[i];
@@ -295,15 +838,14 @@ void APIENTRY_GL4ES gl4es_glBufferSubData(GLenum target, GLintptr offset, GLsize
         errorShim(GL_INVALID_VALUE);
         return;
     }
+    realize_pack_buffer(buff);
 
-    if((target==GL_ARRAY_BUFFER || target==GL_ELEMENT_ARRAY_BUFFER) && buff->real_buffer) {
-        LOAD_GLES(glBufferSubData);
-        LOAD_GLES(glBindBuffer);
-        bindBuffer(target, buff->real_buffer);
-        gles_glBufferSubData(target, offset, size, data);
-    }
+    if((target==GL_ARRAY_BUFFER || target==GL_ELEMENT_ARRAY_BUFFER) && buff->real_buffer)
+        real_buffer_subdata(buff, target, offset, size, data);
         
-    memcpy((char*)buff->data + offset, data, size);
+    if(buff->data)
+        memcpy((char*)buff->data + offset, data, size);
+    changed_range(buff, offset, offset+size);
     noerrorShim();
 }
 void APIENTRY_GL4ES gl4es_glNamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const GLvoid * data) {
@@ -318,14 +860,13 @@ void APIENTRY_GL4ES gl4es_glNamedBufferSubData(GLuint buffer, GLintptr offset, G
         errorShim(GL_INVALID_VALUE);
         return;
     }
+    realize_pack_buffer(buff);
         
-    if((buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) && buff->real_buffer) {
-        LOAD_GLES(glBufferSubData);
-        LOAD_GLES(glBindBuffer);
-        bindBuffer(buff->type, buff->real_buffer);
-        gles_glBufferSubData(buff->type, offset, size, data);
-    }
-    memcpy((char*)buff->data + offset, data, size);
+    if((buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) && buff->real_buffer)
+        real_buffer_subdata(buff, buff->type, offset, size, data);
+    if(buff->data)
+        memcpy((char*)buff->data + offset, data, size);
+    changed_range(buff, offset, offset+size);
     noerrorShim();
 }
 
@@ -348,6 +889,7 @@ void APIENTRY_GL4ES gl4es_glDeleteBuffers(GLsizei n, const GLuint * buffers) {
                     buff = kh_value(list, k);
                     if(buff->real_buffer) {
                         rebind_real_buff_arrays(buff->real_buffer, 0);  // unbind
+                        free_ring(buff);
                         LOAD_GLES(glDeleteBuffers);
                         deleteSingleBuffer(buff->real_buffer);
                     }
@@ -366,7 +908,13 @@ void APIENTRY_GL4ES gl4es_glDeleteBuffers(GLsizei n, const GLuint * buffers) {
                             glstate->vao->vertexattrib[j].real_pointer = 0;
                         }
                     DBG(printf("\t buff->data = %p\n", buff->data);)
+                    if (buff->gpuonly) --gpuonly_count;
+                    if (buff->pbo) deleteSingleBuffer(buff->pbo);
+                    if (buff->upbo) deleteSingleBuffer(buff->upbo);
+                    for (int j = 0; j < buff->nb_conv; j++)
+                        deleteSingleBuffer(buff->conv[j].real_buffer);
                     if (buff->data) free(buff->data);
+                    free(buff->snapshot);
                     kh_del(buff, list, k);
                     free(buff);
                 }
@@ -464,9 +1012,12 @@ void* APIENTRY_GL4ES gl4es_glMapBuffer(GLenum target, GLenum access) {
         errorShim(GL_INVALID_OPERATION);
         return NULL;
     }
+    realize_buffer_shadow(buff);
+    realize_pack_buffer(buff);
 	buff->access = access;	// not used
 	buff->mapped = 1;
     buff->ranged = 0;
+    map_snapshot(buff, 0, buff->size, access!=GL_READ_ONLY);
 	noerrorShim();
 	return buff->data;		// Not nice, should do some copy or something probably
 }
@@ -482,9 +1033,12 @@ void* APIENTRY_GL4ES gl4es_glMapNamedBuffer(GLuint buffer, GLenum access) {
         errorShim(GL_INVALID_OPERATION);
         return NULL;
     }
+    realize_buffer_shadow(buff);
+    realize_pack_buffer(buff);
 	buff->access = access;	// not used
 	buff->mapped = 1;
     buff->ranged = 0;
+    map_snapshot(buff, 0, buff->size, access!=GL_READ_ONLY);
 	noerrorShim();
 	return buff->data;		// Not nice, should do some copy or something probably
 }
@@ -508,23 +1062,7 @@ GLboolean APIENTRY_GL4ES gl4es_glUnmapBuffer(GLenum target) {
 		return GL_FALSE;
     }
 	noerrorShim();
-    if(buff->real_buffer && (buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) && buff->mapped && !buff->ranged && (buff->access==GL_WRITE_ONLY || buff->access==GL_READ_WRITE)) {
-        LOAD_GLES(glBufferSubData);
-        LOAD_GLES(glBindBuffer);
-        bindBuffer(buff->type, buff->real_buffer);
-        gles_glBufferSubData(buff->type, 0, buff->size, buff->data);
-    }
-    if(buff->real_buffer && (buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) && buff->mapped && buff->ranged && (buff->access&GL_MAP_WRITE_BIT_EXT) && !(buff->access&GL_MAP_FLUSH_EXPLICIT_BIT_EXT)) {
-        LOAD_GLES(glBufferSubData);
-        bindBuffer(buff->type, buff->real_buffer);
-        gles_glBufferSubData(buff->type, buff->offset, buff->length, (void*)((uintptr_t)buff->data+buff->offset));
-    }
-    if (buff->mapped) {
-		buff->mapped = 0;
-        buff->ranged = 0;
-		return GL_TRUE;
-	}
-	return GL_FALSE;
+    return unmap_buffer(buff);
 }
 GLboolean APIENTRY_GL4ES gl4es_glUnmapNamedBuffer(GLuint buffer) {
     DBG(printf("glUnmapNamedBuffer(%u)\n", buffer);)
@@ -535,24 +1073,7 @@ GLboolean APIENTRY_GL4ES gl4es_glUnmapNamedBuffer(GLuint buffer) {
 	if (buff==NULL)
 		return GL_FALSE;		// Should generate an error!
 	noerrorShim();
-    if(buff->real_buffer && (buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) && buff->mapped && (buff->access==GL_WRITE_ONLY || buff->access==GL_READ_WRITE)) {
-        LOAD_GLES(glBufferSubData);
-        LOAD_GLES(glBindBuffer);
-        bindBuffer(buff->type, buff->real_buffer);
-        gles_glBufferSubData(buff->type, 0, buff->size, buff->data);
-    }
-    if(buff->real_buffer && (buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) && buff->mapped && buff->ranged && (buff->access&GL_MAP_WRITE_BIT_EXT) && !(buff->access&GL_MAP_FLUSH_EXPLICIT_BIT_EXT)) {
-        LOAD_GLES(glBufferSubData);
-        LOAD_GLES(glBindBuffer);
-        bindBuffer(buff->type, buff->real_buffer);
-        gles_glBufferSubData(buff->type, buff->offset, buff->length, (void*)((uintptr_t)buff->data+buff->offset));
-    }
-	if (buff->mapped) {
-		buff->mapped = 0;
-        buff->ranged = 0;
-		return GL_TRUE;
-	}
-	return GL_FALSE;
+    return unmap_buffer(buff);
 }
 
 void APIENTRY_GL4ES gl4es_glGetBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, GLvoid * data) {
@@ -566,6 +1087,8 @@ void APIENTRY_GL4ES gl4es_glGetBufferSubData(GLenum target, GLintptr offset, GLs
 	if (buff==NULL)
 		return;		// Should generate an error!
 	// TODO, check parameter consistancie
+    realize_buffer_shadow(buff);
+    realize_pack_buffer(buff);
     memcpy(data, (char*)buff->data+offset, size);
 	noerrorShim();
 }
@@ -576,6 +1099,8 @@ void APIENTRY_GL4ES gl4es_glGetNamedBufferSubData(GLuint buffer, GLintptr offset
 	if (buff==NULL)
 		return;		// Should generate an error!
 	// TODO, check parameter consistancie
+    realize_buffer_shadow(buff);
+    realize_pack_buffer(buff);
     memcpy(data, (char*)buff->data+offset, size);
 	noerrorShim();
 }
@@ -632,12 +1157,17 @@ void* APIENTRY_GL4ES gl4es_glMapBufferRange(GLenum target, GLintptr offset, GLsi
         errorShim(GL_INVALID_OPERATION);
         return NULL;
     }
+    realize_buffer_shadow(buff);
+    realize_pack_buffer(buff);
 	buff->access = access;
 	buff->mapped = 1;
     buff->ranged = 1;
     buff->offset = offset;
     buff->length = length;
-	noerrorShim();
+    // no need to compare with previous content if it's invalidated anyway
+    if(!(access&(GL_MAP_INVALIDATE_RANGE_BIT_EXT|GL_MAP_INVALIDATE_BUFFER_BIT_EXT|GL_MAP_FLUSH_EXPLICIT_BIT_EXT)))
+        map_snapshot(buff, offset, length, access&GL_MAP_WRITE_BIT_EXT);
+    noerrorShim();
     uintptr_t ret = (uintptr_t)buff->data;
     ret += offset;
 	return (void*)ret;
@@ -664,9 +1194,10 @@ void APIENTRY_GL4ES gl4es_glFlushMappedBufferRange(GLenum target, GLintptr offse
     }
 
     if(buff->real_buffer && (buff->type==GL_ARRAY_BUFFER || buff->type==GL_ELEMENT_ARRAY_BUFFER) && (buff->access&GL_MAP_WRITE_BIT_EXT)) {
-        LOAD_GLES(glBufferSubData);
-        bindBuffer(buff->type, buff->real_buffer);
-        gles_glBufferSubData(buff->type, buff->offset+offset, length, (void*)((uintptr_t)buff->data+buff->offset+offset));
+        // uploaded on unmap, unless the mapping is persistent
+        dirty_range(buff, buff->offset+offset, buff->offset+offset+length);
+        if(buff->access&GL_MAP_PERSISTENT_BIT)
+            upload_dirty(buff);
     }
 }
 
@@ -684,8 +1215,13 @@ void APIENTRY_GL4ES gl4es_glCopyBufferSubData(GLenum readTarget, GLenum writeTar
         errorShim(GL_INVALID_OPERATION);
         return;
     }
+    realize_buffer_shadow(readbuff);
+    realize_buffer_shadow(writebuff);
+    realize_pack_buffer(readbuff);
+    realize_pack_buffer(writebuff);
     // TODO: check memory overlap and overread/overwrite
     memcpy((char*)writebuff->data+writeOffset, (char*)readbuff->data+readOffset, size);
+    changed_range(writebuff, writeOffset, writeOffset+size);
     if(writebuff->real_buffer && (writebuff->type==GL_ARRAY_BUFFER || writebuff->type==GL_ELEMENT_ARRAY_BUFFER) && writebuff->mapped && (writebuff->access==GL_WRITE_ONLY || writebuff->access==GL_READ_WRITE)) {
         LOAD_GLES(glBufferSubData);
         bindBuffer(writebuff->type, writebuff->real_buffer);
@@ -862,6 +1398,7 @@ void APIENTRY_GL4ES gl4es_glBindVertexArray(GLuint array) {
         }
         glstate->vao = glvao;
     }
+    realize_vao_pack_buffers(glstate->vao);
 
     noerrorShim();
 }
@@ -913,6 +1450,7 @@ void VaoSharedClear(glvao_t *vao) {
         free(vao->color.ptr);
         free(vao->secondary.ptr);
         free(vao->normal.ptr);
+        free(vao->fog.ptr);
         for (int i=0; i<hardext.maxtex; i++)
             free(vao->tex[i].ptr);
         free(vao->shared_arrays);
@@ -921,6 +1459,7 @@ void VaoSharedClear(glvao_t *vao) {
     vao->color.ptr = NULL;
     vao->secondary.ptr = NULL;
     vao->normal.ptr = NULL;
+    vao->fog.ptr = NULL;
     for (int i=0; i<hardext.maxtex; i++)
         vao->tex[i].ptr = NULL;
     vao->shared_arrays = NULL;
@@ -6,6 +6,31 @@
 #include "gles.h"
 
 // VBO *****************
+#define MAX_DIRTY   8
+#define MAX_RING    4
+#define MAX_CONVCACHE 4
+#define MAX_RANGECACHE 8
+
+// a vertex attribute of a buffer, converted to float in a real VBO (starting at vertex 0)
+typedef struct {
+    GLuint      real_buffer;
+    uintptr_t   offset;
+    GLint       size;
+    GLenum      type;
+    GLsizei     stride;
+    GLsizei     count;      // vertices converted
+    GLintptr    dirty_start, dirty_end; // range of the buffer changed since the conversion
+} convattrib_t;
+
+// min/max of some indices of an element buffer
+typedef struct {
+    uintptr_t   offset;
+    GLsizei     count;
+    GLenum      type;
+    unsigned int generation;
+    GLsizei     min, max;
+} indexrange_t;
+
 typedef struct {
     GLuint      buffer;
     GLuint      real_buffer;
@@ -18,6 +43,39 @@ typedef struct {
     GLintptr    offset;
     GLsizeiptr  length;
     GLvoid     *data;
+    int         gpuonly;    // no CPU copy for now, datas are only in real_buffer (and data is NULL)
+    int         keepshadow; // CPU copy was needed once, so always keep it
+    // modified ranges of a mapped buffer, uploaded on unmap
+    int         nb_dirty;
+    GLintptr    dirty_start[MAX_DIRTY];
+    GLintptr    dirty_end[MAX_DIRTY];
+    void       *snapshot;   // copy of the mapped range, to find what changed (LIBGL_MAPDIFF)
+    // ring of real buffers for streaming, real_buffer is ring[ring_idx] (LIBGL_VBORING)
+    int         nb_ring;
+    int         ring_idx;
+    GLuint      ring[MAX_RING];
+    // pending async glReadPixels, in a real PBO (GLES3)
+    GLuint      pbo;
+    GLsizeiptr  pbo_size;
+    int         pbo_pending;
+    GLintptr    pbo_offset;     // destination of the pixels in data
+    GLsizei     pbo_width, pbo_height;
+    GLenum      pbo_format, pbo_type;       // format in the PBO
+    GLenum      pbo_dstformat, pbo_dsttype; // format asked by the application
+    GLint       pbo_align;
+    // bumped each time data may have changed
+    unsigned int generation;
+    // real PBO with a copy of data, for texture uploads from an unpack buffer (GLES3)
+    GLuint      upbo;
+    GLsizeiptr  upbo_size;
+    GLintptr    upbo_start, upbo_end;   // range of data changed since the last upload
+    // converted copies of BGRA / DOUBLE attributes, in real VBO
+    int         nb_conv;
+    convattrib_t conv[MAX_CONVCACHE];
+    // min/max of indices already scanned
+    int         nb_range;
+    int         range_idx;
+    indexrange_t range[MAX_RANGECACHE];
 } glbuffer_t;
 
 KHASH_MAP_DECLARE_INT(buff, glbuffer_t *);
@@ -73,6 +131,12 @@ void bindBuffer(GLenum target, GLuint buffer);
 void deleteSingleBuffer(GLuint buffer);
 // unbound all buffer
 void unboundBuffers();
+// read pixels from current read framebuffer to a real PBO, the conversion will be done when data is needed
+void readpixels_to_pbo(glbuffer_t *buff, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLenum dstformat, GLenum dsttype, GLintptr offset);
+// finish the pending async glReadPixels of the buffer, if any
+void realize_pack_buffer(glbuffer_t *buff);
+// bind (on GLES side) a real unpack buffer with the content of buff, upload it first if needed. NULL to unbind
+void bind_unpack_pbo(glbuffer_t *buff);
 // update wanted Index Buffer
 GLuint wantBufferIndex(GLuint buffer);
 // Bind the wanted index buffer if needed
@@ -212,6 +276,8 @@ typedef struct {
     pointer_cache_t fog;
     pointer_cache_t tex[MAX_TEX];
     int cache_count;
+    unsigned int cache_hash;    // sampled hash of the cached arrays, to catch changes of client arrays
+    int cache_backoff;          // draws to wait before caching the default VAO again
     // Vertex Attrib
     vertexattrib_t  vertexattrib[MAX_VATTRIB];
     // TODO: Cache VA also?
@@ -220,6 +286,15 @@ typedef struct {
 void VaoSharedClear(glvao_t *vao);
 void VaoInit(glvao_t *vao);
 
+// get back the CPU copy of a buffer that lives only on the GPU
+void realize_buffer_shadow(glbuffer_t *buff);
+// same, for the buffer used by a vertex attrib
+void realize_attrib_shadow(vertexattrib_t *v);
+// same, for all enabled arrays of a VAO, before they are read on the CPU side
+void realize_arrays_shadow(glvao_t *vao);
+// real VBO with the (BGRA or DOUBLE) attrib converted to float, from the cache of its buffer. 0 if not possible
+GLuint converted_attrib(vertexattrib_t *v);
+
 KHASH_MAP_DECLARE_INT(glvao, glvao_t*);
 
 void APIENTRY_GL4ES gl4es_glGenVertexArrays(GLsizei n, GLuint *arrays);
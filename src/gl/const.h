@@ -793,6 +793,10 @@
 #define GL_NUM_PROGRAM_BINARY_FORMATS_OES       0x87FE
 #define GL_PROGRAM_BINARY_FORMATS_OES           0x87FF
 
+//GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR      0x91B0
+#define GL_COMPLETION_STATUS_KHR                0x91B1
+
 //Clamp color
 #define GL_CLAMP_READ_COLOR                     0x891C
 
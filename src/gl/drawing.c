@@ -24,7 +24,6 @@ static GLboolean is_cache_compatible(GLsizei count) {
     #define TEST(A,B) T2(vertexattrib[A].enabled, A, B)
     #define TESTA(A,B,I) T2(vertexattrib[A+i].enabled, A+i, B[i])
 
-    if(glstate->vao == glstate->defaultvao) return GL_FALSE;
     if(count > glstate->vao->cache_count) return GL_FALSE;
     TEST(ATT_VERTEX, vert)
     TEST(ATT_COLOR, color)
@@ -40,6 +39,53 @@ static GLboolean is_cache_compatible(GLsizei count) {
     return GL_TRUE;
 }
 
+// hash of the content of an array (or generation of its buffer), as client arrays can change without notice
+static unsigned int hash_attrib(unsigned int h, vertexattrib_t *w, GLsizei count) {
+    if(w->buffer) {
+        h = (h ^ (uintptr_t)w->buffer) * 16777619u;
+        return (h ^ w->buffer->generation) * 16777619u;
+    }
+    if(!w->pointer || count<=0)
+        return h;
+    const int elsize = (w->size==GL_BGRA)?4:(w->size*gl_sizeof(w->type));
+    const int stride = w->stride?w->stride:elsize;
+    // every element is hashed, a sample would miss partial updates of client memory
+    const GLubyte *p = (const GLubyte*)w->pointer;
+    for (int k=0; k<count; k++, p+=stride)
+        for (int j=0; j<elsize; j++)
+            h = (h ^ p[j]) * 16777619u;
+    return h;
+}
+
+static unsigned int arrays_hash(GLsizei count) {
+    unsigned int h = 2166136261u;
+    #define GO(A) if(glstate->vao->vertexattrib[A].enabled) h = hash_attrib(h, &glstate->vao->vertexattrib[A], count);
+    GO(ATT_VERTEX)
+    GO(ATT_COLOR)
+    GO(ATT_SECONDARY)
+    GO(ATT_FOGCOORD)
+    GO(ATT_NORMAL)
+    for (int i=0; i<hardext.maxtex; i++) {
+        GO(ATT_MULTITEXCOORD0+i)
+    }
+    #undef GO
+    return h;
+}
+
+// drop the vao cache if it cannot be used for count vertices
+static void check_vao_cache(GLsizei count) {
+    if(!glstate->vao->shared_arrays) {
+        if(glstate->vao->cache_backoff)
+            --glstate->vao->cache_backoff;
+        return;
+    }
+    if (!is_cache_compatible(count) || arrays_hash(glstate->vao->cache_count)!=glstate->vao->cache_hash) {
+        VaoSharedClear(glstate->vao);
+        // arrays layout or content is changing, wait a bit before caching them again
+        glstate->vao->cache_backoff = 16;
+    }
+}
+
 GLboolean is_list_compatible(renderlist_t* list) {
     #define T2(AA, A, B) \
     if(glstate->vao->AA!=(list->B!=NULL)) return GL_FALSE;
@@ -67,6 +113,7 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
     if (! list)
         list = alloc_renderlist();
     DBG(LOGD("arrary_to_renderlist, compiling=%d, skip=%d, count=%d\n", glstate->list.compiling, skip, count);)
+    realize_arrays_shadow(glstate->vao);
     list->mode = mode;
     list->mode_init = mode;
     list->mode_dimension = rendermode_dimensions(mode);
@@ -74,10 +121,7 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
     list->cap = count-skip;
 
     // check cache if any
-    if(glstate->vao->shared_arrays)  {
-        if (!is_cache_compatible(count))
-            VaoSharedClear(glstate->vao);
-    }
+    check_vao_cache(count);
     
     if(glstate->vao->shared_arrays) {
         #define OP(A, N) (A)?(A+skip*N):NULL
@@ -93,7 +137,14 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
         list->shared_arrays = glstate->vao->shared_arrays;
         (*glstate->vao->shared_arrays)++;
     } else {
-        if(!globals4es.novaocache && glstate->vao != glstate->defaultvao) {
+        // locked arrays will not change, so cache the whole locked range
+        GLsizei ccount = count;
+        if(glstate->vao->locked && glstate->vao->first+glstate->vao->count > ccount)
+            ccount = glstate->vao->first+glstate->vao->count;
+        // the cache starts at vertex 0: client arrays may not be valid below skip (and
+        // glDrawArrays walking a big array would copy it again and again), unless locked from 0
+        int cacheable = (glstate->vao!=glstate->defaultvao) || !skip || (glstate->vao->locked && !glstate->vao->first);
+        if(!globals4es.novaocache && !glstate->vao->cache_backoff && cacheable) {
             // prepare a vao cache object
             list->shared_arrays = glstate->vao->shared_arrays = (int*)malloc(sizeof(int));
             *glstate->vao->shared_arrays = 2; // already shared between glstate & list
@@ -110,14 +161,15 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
             for (int i=0; i<hardext.maxtex; i++) {
                 GOA(ATT_MULTITEXCOORD0,tex,i)
             }
-            glstate->vao->cache_count = count;
+            glstate->vao->cache_count = ccount;
+            glstate->vao->cache_hash = arrays_hash(ccount);
             #undef GOA
             #undef GO
             #undef G2
         }
         if (glstate->vao->vertexattrib[ATT_VERTEX].enabled) {
             if(glstate->vao->shared_arrays) {
-                glstate->vao->vert.ptr = copy_gl_pointer_tex(&glstate->vao->vertexattrib[ATT_VERTEX], 4, 0, count);
+                glstate->vao->vert.ptr = copy_gl_pointer_tex(&glstate->vao->vertexattrib[ATT_VERTEX], 4, 0, ccount);
                 list->vert = glstate->vao->vert.ptr + 4*skip;
             } else
                 list->vert = copy_gl_pointer_tex(&glstate->vao->vertexattrib[ATT_VERTEX], 4, skip, count);
@@ -125,9 +177,9 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
         if (glstate->vao->vertexattrib[ATT_COLOR].enabled) {
             if(glstate->vao->shared_arrays) {
                 if(glstate->vao->vertexattrib[ATT_COLOR].size==GL_BGRA)
-                    glstate->vao->color.ptr = copy_gl_pointer_color_bgra(glstate->vao->vertexattrib[ATT_COLOR].pointer, glstate->vao->vertexattrib[ATT_COLOR].stride, 4, 0, count);
+                    glstate->vao->color.ptr = copy_gl_pointer_color_bgra(glstate->vao->vertexattrib[ATT_COLOR].pointer, glstate->vao->vertexattrib[ATT_COLOR].stride, 4, 0, ccount);
                 else
-                    glstate->vao->color.ptr = copy_gl_pointer_color(&glstate->vao->vertexattrib[ATT_COLOR], 4, 0, count);
+                    glstate->vao->color.ptr = copy_gl_pointer_color(&glstate->vao->vertexattrib[ATT_COLOR], 4, 0, ccount);
                 list->color = glstate->vao->color.ptr + 4*skip;
             } else {
                 if(glstate->vao->vertexattrib[ATT_COLOR].size==GL_BGRA)
@@ -139,9 +191,9 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
         if (glstate->vao->vertexattrib[ATT_SECONDARY].enabled/* && glstate->enable.color_array*/) {
             if(glstate->vao->shared_arrays) {
                 if(glstate->vao->vertexattrib[ATT_SECONDARY].size==GL_BGRA)
-                    glstate->vao->secondary.ptr = copy_gl_pointer_color_bgra(glstate->vao->vertexattrib[ATT_SECONDARY].pointer, glstate->vao->vertexattrib[ATT_SECONDARY].stride, 4, 0, count);
+                    glstate->vao->secondary.ptr = copy_gl_pointer_color_bgra(glstate->vao->vertexattrib[ATT_SECONDARY].pointer, glstate->vao->vertexattrib[ATT_SECONDARY].stride, 4, 0, ccount);
                 else
-                    glstate->vao->secondary.ptr = copy_gl_pointer(&glstate->vao->vertexattrib[ATT_SECONDARY], 4, 0, count);		// alpha chanel is always 0 for secondary...
+                    glstate->vao->secondary.ptr = copy_gl_pointer(&glstate->vao->vertexattrib[ATT_SECONDARY], 4, 0, ccount);		// alpha chanel is always 0 for secondary...
                 list->secondary = glstate->vao->secondary.ptr + 4*skip;
             } else {
                 if(glstate->vao->vertexattrib[ATT_SECONDARY].size==GL_BGRA)
@@ -152,14 +204,14 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
         }
         if (glstate->vao->vertexattrib[ATT_NORMAL].enabled) {
             if(glstate->vao->shared_arrays) {
-                glstate->vao->normal.ptr = copy_gl_pointer_raw(&glstate->vao->vertexattrib[ATT_NORMAL], 3, 0, count);
+                glstate->vao->normal.ptr = copy_gl_pointer_raw(&glstate->vao->vertexattrib[ATT_NORMAL], 3, 0, ccount);
                 list->normal = glstate->vao->normal.ptr + 3*skip;
             } else
                 list->normal = copy_gl_pointer_raw(&glstate->vao->vertexattrib[ATT_NORMAL], 3, skip, count);
         }
         if (glstate->vao->vertexattrib[ATT_FOGCOORD].enabled) {
             if(glstate->vao->shared_arrays) {
-                glstate->vao->fog.ptr = copy_gl_pointer_raw(&glstate->vao->vertexattrib[ATT_FOGCOORD], 1, 0, count);
+                glstate->vao->fog.ptr = copy_gl_pointer_raw(&glstate->vao->vertexattrib[ATT_FOGCOORD], 1, 0, ccount);
                 list->fogcoord = glstate->vao->fog.ptr + 1*skip;
             } else
                 list->fogcoord = copy_gl_pointer_raw(&glstate->vao->vertexattrib[ATT_FOGCOORD], 1, skip, count);
@@ -167,7 +219,7 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
         for (int i=0; i<glstate->vao->maxtex; i++) {
             if (glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+i].enabled) {
                 if(glstate->vao->shared_arrays) {
-                    glstate->vao->tex[i].ptr = copy_gl_pointer_tex(&glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+i], 4, 0, count);
+                    glstate->vao->tex[i].ptr = copy_gl_pointer_tex(&glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+i], 4, 0, ccount);
                     list->tex[i] = glstate->vao->tex[i].ptr + 4*skip;
                 } else
                     list->tex[i] = copy_gl_pointer_tex(&glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+i], 4, skip, count);
@@ -181,11 +233,9 @@ renderlist_t *arrays_to_renderlist(renderlist_t *list, GLenum mode,
 static renderlist_t *arrays_add_renderlist(renderlist_t *a, GLenum mode,
                                         GLsizei skip, GLsizei count, GLushort* indices, int ilen_b) {
     DBG(LOGD("arrays_add_renderlist(%p, %s, %d, %d, %p, %d)\n", a, PrintEnum(mode), skip, count, indices, ilen_b);)
+    realize_arrays_shadow(glstate->vao);
     // check cache if any
-    if(glstate->vao->shared_arrays)  {
-        if (!is_cache_compatible(count))
-            VaoSharedClear(glstate->vao);
-    }
+    check_vao_cache(count);
     // append all draw elements of b in a
     // check the final indice size of a and b
     int ilen_a = a->ilen;
@@ -355,6 +405,7 @@ if(count>500000) return;
     }
     // of course, GL_SELECT with shader will just not work if not using standard transformation method... Instance count is ignored also
     if (glstate->render_mode == GL_SELECT) {
+        realize_attrib_shadow(&glstate->vao->vertexattrib[ATT_VERTEX]);    // vertices are read on the CPU side
         // TODO handling uint indices
         if(!sindices && !iindices)
             select_glDrawArrays(&glstate->vao->vertexattrib[ATT_VERTEX], mode, first, count);
@@ -411,8 +462,6 @@ if(count>500000) return;
         if(hardext.esversion>1 && globals4es.usevbo==2 && glstate->vao->locked==1) {
             // can now browse all enabled VA, and put the corresponding data in a VBO
             // warning, with the use of first 
-            // Checking only Vertex Attrib for now!
-            // TODO: check all va, and take care of interleaved ones...
             ToBuffer(glstate->vao->first, glstate->vao->count);
         }
         if(hardext.esversion>1 && globals4es.usevbo==3 && (glstate->vao->locked==1 || glstate->vao->locked==2)) {
@@ -451,6 +500,61 @@ if(count>500000) return;
     }
 }
 
+// renderlist indices are GLushort, so a merged list must stay under 65536 vertices
+static int list_can_merge(renderlist_t* list, GLsizei count) {
+    return (list->len+count<=65536);
+}
+
+void APIENTRY_GL4ES gl4es_glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void *indices);
+
+// Draw GL_UNSIGNED_INT indices that doesn't fit in GLushort in chunks of primitives
+// whose vertex range fits in 65536 vertices, each chunk going through glDrawRangeElements
+// return 0 if the primitive cannot be split that way
+static int draw_split_elements(GLenum mode, GLsizei count, const GLuint *inds, const void *indices) {
+    int prim, overlap;
+    switch(mode) {
+        case GL_POINTS: prim=1; overlap=0; break;
+        case GL_LINES: prim=2; overlap=0; break;
+        case GL_TRIANGLES: prim=3; overlap=0; break;
+        case GL_QUADS: prim=4; overlap=0; break;
+        case GL_LINE_STRIP: prim=1; overlap=1; break;
+        case GL_TRIANGLE_STRIP: // restart on an even vertex to keep the winding
+        case GL_QUAD_STRIP: prim=2; overlap=2; break;
+        default: return 0;  // fan, loop and polygon cannot be split
+    }
+    DBG(printf("draw_split_elements(%s, %d, %p)\n", PrintEnum(mode), count, indices);)
+    GLsizei s = 0;
+    while(s+overlap<count) {
+        GLsizei e = s;
+        GLuint mi = inds[s], ma = inds[s];
+        for (; e<s+overlap; ++e) {
+            if(inds[e]<mi) mi = inds[e];
+            if(inds[e]>ma) ma = inds[e];
+        }
+        while(e<count) {
+            GLsizei n = (e+prim<=count)?prim:(overlap?count-e:0);
+            if(!n)
+                break;
+            GLuint cmi = mi, cma = ma;
+            for (GLsizei k=e; k<e+n; ++k) {
+                if(inds[k]<cmi) cmi = inds[k];
+                if(inds[k]>cma) cma = inds[k];
+            }
+            if(cma-cmi>65535 && e>s+overlap)
+                break;
+            mi = cmi; ma = cma;
+            e += n;
+        }
+        if(e==s+overlap)
+            break;  // remaining vertices are not a full primitive
+        // a single primitive spanning more than 65536 vertices cannot be drawn
+        if(ma-mi<=65535)
+            gl4es_glDrawRangeElements(mode, mi, ma, e-s, GL_UNSIGNED_INT, (const GLuint*)indices+s);
+        s = e-overlap;
+    }
+    return 1;
+}
+
 #define MIN_BATCH  globals4es.minbatch
 #define MAX_BATCH  globals4es.maxbatch
 
@@ -479,6 +583,13 @@ void APIENTRY_GL4ES gl4es_glDrawRangeElements(GLenum mode, GLuint start, GLuint
             glstate->list.active = alloc_renderlist();
         }
     }
+    if(!compiling && !intercept && type==GL_UNSIGNED_INT && !hardext.elementuint && end>65535)
+        intercept = true;   // go through a renderlist to rebase the indices
+    if((compiling || intercept) && type==GL_UNSIGNED_INT && end-start>65535) {
+        const GLuint *inds = (glstate->vao->elements)?((void*)((char*)glstate->vao->elements->data + (uintptr_t)indices)):(GLvoid*)indices;
+        if(draw_split_elements(mode, count, inds, indices))
+            return;
+    }
 
 	noerrorShim();
     GLushort *sindices = NULL;
@@ -508,7 +619,7 @@ void APIENTRY_GL4ES gl4es_glDrawRangeElements(GLenum mode, GLuint start, GLuint
         }
         for (int i=0; i<count; i++) sindices[i]-=start; //TODO: should be optimizable
 
-        if(globals4es.mergelist && list->stage>=STAGE_DRAW && is_list_compatible(list) && !list->use_glstate && sindices) {
+        if(globals4es.mergelist && list->stage>=STAGE_DRAW && is_list_compatible(list) && !list->use_glstate && sindices && list_can_merge(list, end+1-start)) {
             list = NewDrawStage(list, mode);
             if(list->vert) {
                 glstate->list.active = arrays_add_renderlist(list, mode, start, end + 1, sindices, count);
@@ -560,7 +671,6 @@ AliasExport(void,glDrawRangeElements,EXT,(GLenum mode,GLuint start,GLuint end,GL
 
 void APIENTRY_GL4ES gl4es_glDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices) {
     DBG(printf("glDrawElements(%s, %d, %s, %p), vtx=%p map=%p, pending=%d\n", PrintEnum(mode), count, PrintEnum(type), indices, (glstate->vao->vertex)?glstate->vao->vertex->data:NULL, (glstate->vao->elements)?glstate->vao->elements->data:NULL, glstate->list.pending);)
-    // TODO: split for count > 65535?
     // special check for QUADS and TRIANGLES that need multiple of 4 or 3 vertex...
     count = adjust_vertices(mode, count);
     
@@ -585,6 +695,14 @@ void APIENTRY_GL4ES gl4es_glDrawElements(GLenum mode, GLsizei count, GLenum type
             glstate->list.active = alloc_renderlist();
         }
     }
+    if(type==GL_UNSIGNED_INT && (compiling || intercept || !hardext.elementuint)) {
+        // indices will be converted to GLushort, so large meshes need to be split first
+        const GLuint *inds = (glstate->vao->elements)?((void*)((char*)glstate->vao->elements->data + (uintptr_t)indices)):(GLvoid*)indices;
+        GLsizei min, max;
+        getminmax_indices(GL_UNSIGNED_INT, inds, &max, &min, count);
+        if(max>65535 && draw_split_elements(mode, count, inds, indices))
+            return;
+    }
 
 	noerrorShim();
     GLushort *sindices = NULL;
@@ -618,7 +736,7 @@ void APIENTRY_GL4ES gl4es_glDrawElements(GLenum mode, GLsizei count, GLenum type
 
         normalize_indices_us(sindices, &max, &min, count);
 
-        if(globals4es.mergelist && list->stage>=STAGE_DRAW && is_list_compatible(list) && !list->use_glstate && sindices) {
+        if(globals4es.mergelist && list->stage>=STAGE_DRAW && is_list_compatible(list) && !list->use_glstate && sindices && list_can_merge(list, max+1-min)) {
             list = NewDrawStage(list, mode);
             glstate->list.active = arrays_add_renderlist(list, mode, min, max + 1, sindices, count);
             NewStage(glstate->list.active, STAGE_POSTDRAW);
@@ -666,6 +784,47 @@ void APIENTRY_GL4ES gl4es_glDrawElements(GLenum mode, GLsizei count, GLenum type
 }
 AliasExport(void,glDrawElements,,(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices));
 
+// GL_QUADS arrays are drawn as GL_TRIANGLES, using the shared Quads indices (and its VBO) when possible
+static void draw_quads_arrays(GLint first, GLsizei count, int instancecount) {
+    GLushort *sindices = NULL;
+    GLuint *iindices = NULL;
+    int ilen = count*3/2;
+    if((first%4)==0)
+        sindices = gl4es_quad_indices(first+count);
+    if(sindices)
+        sindices += first*3/2;
+    else if(first+count>65536 && hardext.elementuint) {
+        gl4es_scratch(ilen*sizeof(GLuint));
+        iindices = (GLuint*)glstate->scratch;
+        for (int i=0, j=first; i+3<count; i+=4, j+=4) {
+            *(iindices++) = j + 0;
+            *(iindices++) = j + 1;
+            *(iindices++) = j + 2;
+
+            *(iindices++) = j + 0;
+            *(iindices++) = j + 2;
+            *(iindices++) = j + 3;
+        }
+        iindices = (GLuint*)glstate->scratch;
+    } else {
+        gl4es_scratch(ilen*sizeof(GLushort));
+        sindices = (GLushort*)glstate->scratch;
+        for (int i=0, j=first; i+3<count; i+=4, j+=4) {
+            *(sindices++) = j + 0;
+            *(sindices++) = j + 1;
+            *(sindices++) = j + 2;
+
+            *(sindices++) = j + 0;
+            *(sindices++) = j + 2;
+            *(sindices++) = j + 3;
+        }
+        sindices = (GLushort*)glstate->scratch;
+    }
+    GLuint old_index = wantBufferIndex(0);
+    glDrawElementsCommon(GL_TRIANGLES, 0, ilen, first+count, sindices, iindices, instancecount);
+    wantBufferIndex(old_index);
+}
+
 void APIENTRY_GL4ES gl4es_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
     DBG(printf("glDrawArrays(%s, %d, %d), list=%p pending=%d\n", PrintEnum(mode), first, count, glstate->list.active, glstate->list.pending);)
     // special check for QUADS and TRIANGLES that need multiple of 4 or 3 vertex...
@@ -705,7 +864,7 @@ void APIENTRY_GL4ES gl4es_glDrawArrays(GLenum mode, GLint first, GLsizei count)
     if (glstate->list.active) {
         renderlist_t *list = glstate->list.active;
         
-        if(globals4es.mergelist && list->stage>=STAGE_DRAW && is_list_compatible(list) && !list->use_glstate) {
+        if(globals4es.mergelist && list->stage>=STAGE_DRAW && is_list_compatible(list) && !list->use_glstate && list_can_merge(list, count)) {
             list = NewDrawStage(list, mode);
             if(list->vert) {
                 glstate->list.active = arrays_add_renderlist(list, mode, first, count+first, NULL, 0);
@@ -733,33 +892,7 @@ void APIENTRY_GL4ES gl4es_glDrawArrays(GLenum mode, GLint first, GLsizei count)
         free_renderlist(list);
     } else {
         if (mode==GL_QUADS) {
-            // TODO: move those static in glstate
-            static GLushort *indices = NULL;
-            static int indcnt = 0;
-            static int indfirst = 0;
-            int realfirst = ((first%4)==0)?0:first;
-            int realcount = count + (first-realfirst);
-            if((indcnt < realcount) || (indfirst!=realfirst)) {
-                if(indcnt < realcount) {
-                    indcnt = realcount;
-                    if (indices) free(indices);
-                    indices = (GLushort*)malloc(sizeof(GLushort)*(indcnt*3/2));
-                }
-                indfirst = realfirst;
-                GLushort *p = indices;
-                for (int i=0, j=indfirst; i+3<indcnt; i+=4, j+=4) {
-                        *(p++) = j + 0;
-                        *(p++) = j + 1;
-                        *(p++) = j + 2;
-
-                        *(p++) = j + 0;
-                        *(p++) = j + 2;
-                        *(p++) = j + 3;
-                }
-            }
-            GLuint old_buffer = wantBufferIndex(0);
-            glDrawElementsCommon(GL_TRIANGLES, 0, count*3/2, count, indices+(first-indfirst)*3/2, NULL, 1);
-            wantBufferIndex(old_buffer);
+            draw_quads_arrays(first, count, 1);
             return;
         }
 
@@ -813,7 +946,7 @@ void APIENTRY_GL4ES gl4es_glMultiDrawArrays(GLenum mode, const GLint *firsts, co
         }
 
         if (compiling) {
-            if(globals4es.mergelist && glstate->list.active->stage>=STAGE_DRAW && is_list_compatible(glstate->list.active) && !glstate->list.active->use_glstate) {
+            if(globals4es.mergelist && glstate->list.active->stage>=STAGE_DRAW && is_list_compatible(glstate->list.active) && !glstate->list.active->use_glstate && list_can_merge(glstate->list.active, count)) {
                 glstate->list.active = NewDrawStage(glstate->list.active, mode);
                 glstate->list.active = arrays_add_renderlist(glstate->list.active, mode, first, count+first, NULL, 0);
                 NewStage(glstate->list.active, STAGE_POSTDRAW);
@@ -833,7 +966,7 @@ void APIENTRY_GL4ES gl4es_glMultiDrawArrays(GLenum mode, const GLint *firsts, co
         if (intercept) {
             if(list) {
                 NewStage(list, STAGE_DRAW);
-                if(globals4es.mergelist && list->stage>=STAGE_DRAW && is_list_compatible(list) && !list->use_glstate) {
+                if(globals4es.mergelist && list->stage>=STAGE_DRAW && is_list_compatible(list) && !list->use_glstate && list_can_merge(list, count)) {
                     list = NewDrawStage(list, mode);
                     list = arrays_add_renderlist(list, mode, first, count+first, NULL, 0);
                     NewStage(list, STAGE_POSTDRAW);
@@ -843,33 +976,7 @@ void APIENTRY_GL4ES gl4es_glMultiDrawArrays(GLenum mode, const GLint *firsts, co
                 list = arrays_to_renderlist(NULL, mode, first, count+first);
         } else {
             if (mode==GL_QUADS) {
-                // TODO: move those static in glstate
-                static GLushort *indices = NULL;
-                static int indcnt = 0;
-                static int indfirst = 0;
-                int realfirst = ((first%4)==0)?0:first;
-                int realcount = count + (first-realfirst);
-                if((indcnt < realcount) || (indfirst!=realfirst)) {
-                    if(indcnt < realcount) {
-                        indcnt = realcount;
-                        if (indices) free(indices);
-                        indices = (GLushort*)malloc(sizeof(GLushort)*(indcnt*3/2));
-                    }
-                    indfirst = realfirst;
-                    GLushort *p = indices;
-                    for (int k=0, j=indfirst; k+3<indcnt; k+=4, k+=4) {
-                            *(p++) = j + 0;
-                            *(p++) = j + 1;
-                            *(p++) = j + 2;
-
-                            *(p++) = j + 0;
-                            *(p++) = j + 2;
-                            *(p++) = j + 3;
-                    }
-                }
-                GLuint old_index = wantBufferIndex(0);
-                glDrawElementsCommon(GL_TRIANGLES, 0, count*3/2, count, indices+(first-indfirst)*3/2, NULL, 1);
-                wantBufferIndex(old_index);
+                draw_quads_arrays(first, count, 1);
                 continue;
             }
 
@@ -1382,33 +1489,7 @@ void APIENTRY_GL4ES gl4es_glDrawArraysInstanced(GLenum mode, GLint first, GLsize
         free_renderlist(list);
     } else {
         if (mode==GL_QUADS) {
-            // TODO: move those static in glstate
-            static GLushort *indices = NULL;
-            static int indcnt = 0;
-            static int indfirst = 0;
-            int realfirst = ((first%4)==0)?0:first;
-            int realcount = count + (first-realfirst);
-            if((indcnt < realcount) || (indfirst!=realfirst)) {
-                if(indcnt < realcount) {
-                    indcnt = realcount;
-                    if (indices) free(indices);
-                    indices = (GLushort*)malloc(sizeof(GLushort)*(indcnt*3/2));
-                }
-                indfirst = realfirst;
-                GLushort *p = indices;
-                for (int i=0, j=indfirst; i+3<indcnt; i+=4, j+=4) {
-                        *(p++) = j + 0;
-                        *(p++) = j + 1;
-                        *(p++) = j + 2;
-
-                        *(p++) = j + 0;
-                        *(p++) = j + 2;
-                        *(p++) = j + 3;
-                }
-            }
-            GLuint old_buffer = wantBufferIndex(0);
-            glDrawElementsCommon(GL_TRIANGLES, 0, count*3/2, count, indices+(first-indfirst)*3/2, NULL, primcount);
-            wantBufferIndex(old_buffer);
+            draw_quads_arrays(first, count, primcount);
             return;
         }
 
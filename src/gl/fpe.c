@@ -174,7 +174,9 @@ void APIENTRY_GL4ES fpe_ReleventState(fpe_state_t *dest, fpe_state_t *src, int f
         dest->cm_back_nullexp = 0;
         dest->light_separate = 0;
         dest->light_localviewer = 0;
+        dest->light_mode = 0;
     } else {
+        dest->light_mode = globals4es.fpelighting;
         // indiviual lights
         for (int i=0; i<8; i++) {
             if(((dest->light>>i)&1)==0) {
@@ -285,17 +287,6 @@ int APIENTRY_GL4ES fpe_IsEmpty(fpe_state_t *state) {
     return 1;
 }
 
-uniform_t* findUniform(khash_t(uniformlist) *uniforms, const char* name)
-{
-    uniform_t *m;
-    khint_t k;
-    kh_foreach(uniforms, k, m,
-        if(!strcmp(m->name, name))
-            return m;
-    )
-    return NULL;
-
-}
 // ********* Old Program binding Handling *********
 void APIENTRY_GL4ES fpe_oldprogram(fpe_state_t* state) {
     LOAD_GLES2(glGetShaderInfoLog);
@@ -357,8 +348,8 @@ void APIENTRY_GL4ES fpe_oldprogram(fpe_state_t* state) {
         }
     }
     gl4es_glAttachShader(glstate->fpe->prog, glstate->fpe->frag);
-    // Ok, and now link the program
-    gl4es_glLinkProgram(glstate->fpe->prog);
+    // Ok, and now link the program (not in the PSA by state, so cached by its converted sources)
+    gl4es_linkProgram(glstate->fpe->prog, 1);
     gl4es_glGetProgramiv(glstate->fpe->prog, GL_LINK_STATUS, &status);
     if(status!=GL_TRUE) {
         char buff[1000];
@@ -422,7 +413,7 @@ void APIENTRY_GL4ES fpe_program(int ispoint) {
                 // program is already created
                 gl4es_glAttachShader(glstate->fpe->prog, glstate->fpe->vert);
                 gl4es_glAttachShader(glstate->fpe->prog, glstate->fpe->frag);
-                gl4es_glLinkProgram(glstate->fpe->prog);
+                gl4es_linkProgram(glstate->fpe->prog, 0);
                 gl4es_glGetProgramiv(glstate->fpe->prog, GL_LINK_STATUS, &status);
                 if(status!=GL_TRUE) {
                     char buff[1000];
@@ -449,6 +440,32 @@ void APIENTRY_GL4ES fpe_program(int ispoint) {
     }
 }
 
+// resolve once the uniforms of a fpe custom program that come from the father program
+static void fpe_FatherUniforms(program_t* father, program_t* glprogram)
+{
+    khash_t(uniformlist) *uniforms = glprogram->uniform;
+    uniform_t *m, *n;
+    khint_t k;
+    free(glprogram->sync);
+    free(glprogram->sync_father);
+    glprogram->sync = (uniform_t**)malloc(kh_size(uniforms)*sizeof(uniform_t*));
+    glprogram->sync_father = (uniform_t**)malloc(kh_size(uniforms)*sizeof(uniform_t*));
+    glprogram->sync_size = 0;
+    glprogram->sync_gen = 0;
+    kh_foreach(uniforms, k, m,
+        if(!m->builtin) {
+            n = findUniform(father, m->name, strlen(m->name));
+            if(n) {
+                m->parent_offs = n->cache_offs;
+                m->parent_size = n->cache_size;
+                glprogram->sync[glprogram->sync_size] = m;
+                glprogram->sync_father[glprogram->sync_size] = n;
+                ++glprogram->sync_size;
+            }
+        }
+    )
+}
+
 program_t* APIENTRY_GL4ES fpe_CustomShader(program_t* glprogram, fpe_state_t* state)
 {
     // state is not empty and glprogram already has some cache (it may be empty, but kh'thingy is initialized)
@@ -487,7 +504,7 @@ program_t* APIENTRY_GL4ES fpe_CustomShader(program_t* glprogram, fpe_state_t* st
                 gles_glBindAttribLocation(fpe->prog, al->index, al->name);
             );
         }
-        gl4es_glLinkProgram(fpe->prog);
+        gl4es_linkProgram(fpe->prog, 0);
         gl4es_glGetProgramiv(fpe->prog, GL_LINK_STATUS, &status);
         if(status!=GL_TRUE) {
             char buff[1000];
@@ -504,21 +521,7 @@ program_t* APIENTRY_GL4ES fpe_CustomShader(program_t* glprogram, fpe_state_t* st
                 fpe->glprogram = kh_value(programs, k_program);
         }
         // adjust the uniforms to point to father cache...
-        {
-            khash_t(uniformlist) *father_uniforms = glprogram->uniform;
-            khash_t(uniformlist) *uniforms = fpe->glprogram->uniform;
-            uniform_t *m, *n;
-            khint_t k;
-            kh_foreach(uniforms, k, m,
-                if(!m->builtin) {
-                    n = findUniform(father_uniforms, m->name);
-                    if(n) {
-                        m->parent_offs = n->cache_offs;
-                        m->parent_size = n->cache_size;
-                    }
-                }
-            )
-        }
+        fpe_FatherUniforms(glprogram, fpe->glprogram);
         // all done
         DBG(printf("creating FPE Custom Program : %d(%p)\n", fpe->prog, fpe->glprogram);)
     }
@@ -564,7 +567,7 @@ program_t* APIENTRY_GL4ES fpe_CustomShader_DefaultVertex(program_t* glprogram, f
                 gles_glBindAttribLocation(fpe->prog, al->index, al->name);
             );
         }
-        gl4es_glLinkProgram(fpe->prog);
+        gl4es_linkProgram(fpe->prog, 0);
         gl4es_glGetProgramiv(fpe->prog, GL_LINK_STATUS, &status);
         if(status!=GL_TRUE) {
             char buff[1000];
@@ -581,21 +584,7 @@ program_t* APIENTRY_GL4ES fpe_CustomShader_DefaultVertex(program_t* glprogram, f
                 fpe->glprogram = kh_value(programs, k_program);
         }
         // adjust the uniforms to point to father cache...
-        {
-            khash_t(uniformlist) *father_uniforms = glprogram->uniform;
-            khash_t(uniformlist) *uniforms = fpe->glprogram->uniform;
-            uniform_t *m, *n;
-            khint_t k;
-            kh_foreach(uniforms, k, m,
-                if(!m->builtin) {
-                    n = findUniform(father_uniforms, m->name);
-                    if(n) {
-                        m->parent_offs = n->cache_offs;
-                        m->parent_size = n->cache_size;
-                    }
-                }
-            )
-        }
+        fpe_FatherUniforms(glprogram, fpe->glprogram);
         // all done
         DBG(printf("creating FPE Custom Program : %d(%p)\n", fpe->prog, fpe->glprogram);)
     }
@@ -603,22 +592,23 @@ program_t* APIENTRY_GL4ES fpe_CustomShader_DefaultVertex(program_t* glprogram, f
     return fpe->glprogram;
 }
 
-void APIENTRY_GL4ES fpe_SyncUniforms(uniformcache_t *cache, program_t* glprogram) {
-    //TODO: Optimize this...
-    khash_t(uniformlist) *uniforms = glprogram->uniform;
-    uniform_t *m;
-    khint_t k;
+void APIENTRY_GL4ES fpe_SyncUniforms(program_t* father, program_t* glprogram) {
+    // nothing changed in the father since the last sync
+    if(glprogram->sync_gen == father->uniform_gen)
+        return;
     DBG(int cnt = 0;)
     // don't use m->size, as each element has it's own uniform...
-    kh_foreach(uniforms, k, m,
-        if(m->parent_size) {
+    for (int i=0; i<glprogram->sync_size; i++) {
+        uniform_t *m = glprogram->sync[i];
+        if(glprogram->sync_father[i]->gen > glprogram->sync_gen) {
             DBG(++cnt;)
+            void* v = (void*)((uintptr_t)father->cache.cache+m->parent_offs);
             switch(m->type) {
                 case GL_FLOAT:
                 case GL_FLOAT_VEC2:
                 case GL_FLOAT_VEC3:
                 case GL_FLOAT_VEC4:
-                    GoUniformfv(glprogram, m->id, n_uniform(m->type), 1, (GLfloat*)((uintptr_t)cache->cache+m->parent_offs));
+                    GoUniformfv(glprogram, m->id, n_uniform(m->type), 1, (GLfloat*)v);
                     break;
                 case GL_SAMPLER_2D:
                 case GL_SAMPLER_CUBE:
@@ -630,22 +620,23 @@ void APIENTRY_GL4ES fpe_SyncUniforms(uniformcache_t *cache, program_t* glprogram
                 case GL_BOOL_VEC2:
                 case GL_BOOL_VEC3:
                 case GL_BOOL_VEC4:
-                    GoUniformiv(glprogram, m->id, n_uniform(m->type), 1, (GLint*)((uintptr_t)cache->cache+m->parent_offs));
+                    GoUniformiv(glprogram, m->id, n_uniform(m->type), 1, (GLint*)v);
                     break;
                 case GL_FLOAT_MAT2:
-                    GoUniformMatrix2fv(glprogram, m->id, 1, false, (GLfloat*)((uintptr_t)cache->cache+m->parent_offs));
+                    GoUniformMatrix2fv(glprogram, m->id, 1, false, (GLfloat*)v);
                     break;
                 case GL_FLOAT_MAT3:
-                    GoUniformMatrix3fv(glprogram, m->id, 1, false, (GLfloat*)((uintptr_t)cache->cache+m->parent_offs));
+                    GoUniformMatrix3fv(glprogram, m->id, 1, false, (GLfloat*)v);
                     break;
                 case GL_FLOAT_MAT4:
-                    GoUniformMatrix4fv(glprogram, m->id, 1, false, (GLfloat*)((uintptr_t)cache->cache+m->parent_offs));
+                    GoUniformMatrix4fv(glprogram, m->id, 1, false, (GLfloat*)v);
                     break;
                 default:
                     printf("LIBGL: Warning, sync uniform on father/son program with unknown uniform type %s\n", PrintEnum(m->type));
             }
         }
-    );
+    }
+    glprogram->sync_gen = father->uniform_gen;
     DBG(printf("Uniform sync'd with %d and father (%d uniforms)\n", glprogram->id, cnt);)
 }
 // ********* Fixed Pipeling function wrapper *********
@@ -826,6 +817,11 @@ void APIENTRY_GL4ES fpe_glDrawElements(GLenum mode, GLsizei count, GLenum type,
         bindBuffer(GL_ELEMENT_ARRAY_BUFFER, glstate->vao->elements->real_buffer);
         indices = (GLvoid*)((uintptr_t)indices - (uintptr_t)(glstate->vao->elements->data));
         DBG(printf("Using VBO %d for indices\n", glstate->vao->elements->real_buffer);)
+    } else if(type==GL_UNSIGNED_SHORT && gl4es_is_quad_indices(indices)) {
+        use_vbo = 1;
+        gl4es_use_quad_indices();
+        indices = (GLvoid*)((uintptr_t)indices - (uintptr_t)(glstate->quad_indices));
+        DBG(printf("Using shared Quads VBO %d for indices\n", glstate->quad_indices_buffer);)
     }
     realize_bufferIndex();
     gles_glDrawElements(mode, count, type, indices);
@@ -848,6 +844,7 @@ void APIENTRY_GL4ES fpe_glDrawArraysInstanced(GLenum mode, GLint first, GLsizei
         {
             vertexattrib_t *w = &glstate->vao->vertexattrib[i];
             if(w->divisor && w->enabled) {
+                realize_attrib_shadow(w);   // read on the CPU side
                 char* current = (char*)((uintptr_t)w->pointer + ((w->buffer)?(uintptr_t)w->buffer->data:0));
                 int stride=w->stride;
                 if(!stride) stride=gl_sizeof(w->type)*w->size;
@@ -897,6 +894,10 @@ void APIENTRY_GL4ES fpe_glDrawElementsInstanced(GLenum mode, GLsizei count, GLen
         use_vbo = 1;
         bindBuffer(GL_ELEMENT_ARRAY_BUFFER, glstate->vao->elements->real_buffer);
         inds = (void*)((uintptr_t)indices - (uintptr_t)(glstate->vao->elements->data));
+    } else if(type==GL_UNSIGNED_SHORT && gl4es_is_quad_indices(indices)) {
+        use_vbo = 1;
+        gl4es_use_quad_indices();
+        inds = (void*)((uintptr_t)indices - (uintptr_t)(glstate->quad_indices));
     } else {
         inds = (void*)indices;
         bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -909,6 +910,7 @@ void APIENTRY_GL4ES fpe_glDrawElementsInstanced(GLenum mode, GLsizei count, GLen
         {
             vertexattrib_t *w = &glstate->vao->vertexattrib[i];
             if(w->divisor && w->enabled) {
+                realize_attrib_shadow(w);   // read on the CPU side
                 char* current = (char*)((uintptr_t)w->pointer + ((w->buffer)?(uintptr_t)w->buffer->data:0));
                 int stride=w->stride;
                 if(!stride) stride=gl_sizeof(w->type)*w->size;
@@ -1118,7 +1120,7 @@ void realize_glenv(int ispoint, int first, int count, GLenum type, const void* i
         }
         // synchronize uniforms with parent!
         if(glprogram != glstate->glsl->glprogram)
-            fpe_SyncUniforms(&glstate->glsl->glprogram->cache, glprogram);
+            fpe_SyncUniforms(glstate->glsl->glprogram, glprogram);
     } else {
         fpe_program(ispoint);
         if(glstate->gleshard->program != glstate->fpe->prog)
@@ -1439,10 +1441,13 @@ void realize_glenv(int ispoint, int first, int count, GLenum type, const void* i
         vertexattrib_t *w = &glstate->vao->vertexattrib[i];
         int enabled = w->enabled;
         int dirty = 0;
-        if(enabled && !w->buffer && !w->pointer) {
+        // a legacy pointer at offset 0 of a GPU only buffer is NULL, but still valid
+        if(enabled && !w->buffer && !w->real_buffer && !w->pointer) {
             DBG(printf("Warning: VA %d Enabled with buffer:0 and NULL pointer, disabling\n", i));
             enabled = 0;
         }
+        if(enabled && (w->size==GL_BGRA || w->type==GL_DOUBLE || w->divisor))
+            realize_attrib_shadow(w);   // will be read on the CPU side
         // enable / disable Array if needed
         if(v->enabled != enabled || (v->enabled && w->divisor)) {
             dirty = 1;
@@ -1457,20 +1462,37 @@ void realize_glenv(int ispoint, int first, int count, GLenum type, const void* i
         if(v->enabled) {
             // array case
             void * ptr = (void*)((uintptr_t)w->pointer + ((w->buffer)?(uintptr_t)w->buffer->data:0));
-            if(dirty || v->size!=w->size || v->type!=w->type || v->normalized!=w->normalized 
-                || v->stride!=w->stride || v->buffer!=w->buffer || (w->real_buffer==0 && v->pointer!=ptr)
-                || v->real_buffer!=w->real_buffer || (w->real_buffer!=0 && v->real_pointer != w->real_pointer) 
-                || w->real_buffer!=glstate->bind_buffer.array) {
+            // converted once, and kept in a real VBO while the buffer is unchanged
+            GLuint conv = (w->size==GL_BGRA || w->type==GL_DOUBLE)?converted_attrib(w):0;
+            int changed;
+            if(conv)
+                // the hard state holds the converted attrib, not the VAO one
+                changed = dirty || v->real_buffer!=conv || v->size!=((w->size==GL_BGRA)?4:w->size) || v->type!=GL_FLOAT
+                    || v->normalized || v->integer || v->stride || v->buffer || v->pointer;
+            else
+                changed = dirty || v->size!=w->size || v->type!=w->type || v->normalized!=w->normalized 
+                    || v->stride!=w->stride || v->buffer!=w->buffer || (w->real_buffer==0 && v->pointer!=ptr)
+                    || v->real_buffer!=w->real_buffer || (w->real_buffer!=0 && v->real_pointer != w->real_pointer) 
+                    || w->real_buffer!=glstate->bind_buffer.array;
+            if(changed) {
+                if(conv) {
+                    v->size = (w->size==GL_BGRA)?4:w->size;
+                    v->type = GL_FLOAT;
+                    v->normalized = 0;
+                    v->integer = 0;
+                    v->stride = 0;
+                    v->buffer = NULL;
+                    v->real_buffer = conv;
+                    v->real_pointer = 0;
+                    v->pointer = 0;
+                } else
                 if((w->size==GL_BGRA || w->type==GL_DOUBLE) && scratch->size<8) { 
-                    // need to adjust, so first need the min/max (a shame as I already must have that somewhere)
+                    // need to adjust, so first need the min/max (cached for element buffers)
                     int imin, imax;
                     if(type==0) {
                         imin = first; imax = count;
                     } else {
-                        if(type==GL_UNSIGNED_INT)
-                            getminmax_indices_ui(indices, &imax, &imin, count);
-                        else
-                            getminmax_indices_us(indices, &imax, &imin, count);
+                        getminmax_indices(type, indices, &imax, &imin, count);
                         ++imax;
                     }
                     if(w->size==GL_BGRA) {
@@ -1484,12 +1506,15 @@ void realize_glenv(int ispoint, int first, int count, GLenum type, const void* i
                         v->buffer = NULL;
                         v->real_buffer = 0;
                     } else if (w->type == GL_DOUBLE) {
-                        // TODO
-                        static int warn = 1;
-                        if(warn) {
-                            printf("LIBGL: VertexAttribArray using GL_DOUBLE unimplemented!\n");
-                            warn=0;
-                        }
+                        v->size = w->size;
+                        v->type = GL_FLOAT;
+                        v->normalized = 0;
+                        v->integer = 0;
+                        v->pointer = scratch->scratch[scratch->size++] = copy_gl_array(ptr, GL_DOUBLE, w->size, w->stride, GL_FLOAT, w->size, imin, imax, NULL);
+                        v->pointer = (char*)v->pointer - imin*w->size*sizeof(GLfloat);   // adjust for min...
+                        v->stride = 0;
+                        v->buffer = NULL;
+                        v->real_buffer = 0;
                     }
                 } else {
                     v->size = w->size;
@@ -47,6 +47,10 @@
 #define FPE_CM_DIFFUSE        3
 #define FPE_CM_SPECULAR       4
 
+#define FPE_LIGHT_VERTEX      0
+#define FPE_LIGHT_FRAGMENT    1
+#define FPE_LIGHT_AMBIENT     2
+
 #define FPE_MODULATE          0
 #define FPE_ADD               1
 #define FPE_DECAL             2
@@ -202,6 +206,7 @@ typedef struct fpe_state_s {
     unsigned int cm_back_nullexp:1;      // back material shininess is 0
     unsigned int light_separate:1;       // light separate specular color
     unsigned int light_localviewer:1;    // light local viewer
+    unsigned int light_mode:2;           // where/how lighting is computed (LIBGL_FPELIGHTING)
     unsigned int point:1;                // point rendering
     unsigned int pointsprite:1;          // point sprite rendering
     unsigned int pointsprite_coord:1;    // point sprite coord replace
@@ -3,6 +3,7 @@
 
 #include "../glx/hardext.h"
 #include "init.h"
+#include "loader.h"
 #include "logs.h"
 #include "debug.h"
 #include "program.h"
@@ -31,7 +32,7 @@
 #endif
 
 static const char PSA_SIGN[] = "GL4ES PrecompiledShaderArchive";
-#define CACHE_VERSION 112
+#define CACHE_VERSION 115
 
 static kh_inline khint_t _hash_fpe(fpe_state_t *p)
 {
@@ -97,11 +98,22 @@ typedef struct psa_s {
 
 KHASH_MAP_INIT_FPE(psalist, psa_t *);
 
+// Application programs, keyed by a hash of what was sent to the linker
+typedef struct prgbin_s {
+    uint64_t    key;
+    GLenum      format;
+    int         size;
+    void*       prog;
+} prgbin_t;
+
+KHASH_MAP_INIT_INT64(prgbinlist, prgbin_t *);
+
 // Precompiled Shader Archive
 typedef struct gl4es_psa_s {
     int             size;
     int             dirty;
     kh_psalist_t*   cache;    
+    kh_prgbinlist_t* programs;
 } gl4es_psa_t;
 
 static gl4es_psa_t *psa = NULL;
@@ -175,8 +187,32 @@ void fpe_readPSA()
         kh_value(psa->cache, k) = p;
         psa->size = kh_size(psa->cache);
     }
+    // then the application programs
+    if(fread(&n, sizeof(n), 1, f)!=1) {
+        fclose(f);
+        return;
+    }
+    for (int i=0; i<n; ++i) {
+        prgbin_t *p = (prgbin_t*)calloc(1, sizeof(prgbin_t));
+        if(fread(&p->key, sizeof(p->key), 1, f)!=1 || fread(&p->format, sizeof(p->format), 1, f)!=1
+            || fread(&p->size, sizeof(p->size), 1, f)!=1) {
+            free(p);
+            fclose(f);
+            return;
+        }
+        p->prog = malloc(p->size);
+        if(fread(p->prog, p->size, 1, f)!=1) {
+            free(p->prog);
+            free(p);
+            fclose(f);
+            return;
+        }
+        int ret;
+        khint_t k = kh_put(prgbinlist, psa->programs, p->key, &ret);
+        kh_value(psa->programs, k) = p;
+    }
     fclose(f);
-    SHUT_LOGD("Loaded a PSA with %d Precompiled Programs\n", psa->size);
+    SHUT_LOGD("Loaded a PSA with %d Precompiled Programs and %d Application Programs\n", psa->size, kh_size(psa->programs));
 }
 
 void fpe_writePSA()
@@ -225,8 +261,21 @@ void fpe_writePSA()
             return;
         }
     );
+    int n = kh_size(psa->programs);
+    if(fwrite(&n, sizeof(n), 1, f)!=1) {
+        fclose(f);
+        return;
+    }
+    prgbin_t *b;
+    kh_foreach_value(psa->programs, b, 
+        if(fwrite(&b->key, sizeof(b->key), 1, f)!=1 || fwrite(&b->format, sizeof(b->format), 1, f)!=1
+            || fwrite(&b->size, sizeof(b->size), 1, f)!=1 || fwrite(b->prog, b->size, 1, f)!=1) {
+            fclose(f);
+            return;
+        }
+    );
     fclose(f);
-    SHUT_LOGD("Saved a PSA with %d Precompiled Programs\n", psa->size);
+    SHUT_LOGD("Saved a PSA with %d Precompiled Programs and %d Application Programs\n", psa->size, n);
 }
 
 void fpe_InitPSA(const char* name)
@@ -235,6 +284,7 @@ void fpe_InitPSA(const char* name)
         return; // already inited
     psa = (gl4es_psa_t*)calloc(1, sizeof(gl4es_psa_t));
     psa->cache = kh_init(psalist);
+    psa->programs = kh_init(prgbinlist);
     psa_name = strdup(name);
 }
 
@@ -249,6 +299,12 @@ void fpe_FreePSA()
         free(m);
     )
     kh_destroy(psalist, psa->cache);
+    prgbin_t *b;
+    kh_foreach_value(psa->programs, b, 
+        free(b->prog);
+        free(b);
+    )
+    kh_destroy(prgbinlist, psa->programs);
 
     free(psa);
     psa = NULL;
@@ -300,4 +356,53 @@ void fpe_AddProgramPSA(GLuint program, fpe_state_t* state)
     kh_value(psa->cache, k) = p;
     // all done
     psa->size = kh_size(psa->cache);
-}
\ No newline at end of file
+}
+
+// the same sources can give a different binary on another driver (or driver version)
+static uint64_t driver_key(uint64_t key)
+{
+    static uint64_t driver = 0;
+    if(!driver) {
+        LOAD_GLES(glGetString);
+        const char* strings[2] = {(const char*)gles_glGetString(GL_RENDERER), (const char*)gles_glGetString(GL_VERSION)};
+        driver = 14695981039346656037ULL;
+        for (int i=0; i<2; ++i)
+            for (const char* s = strings[i]; s && *s; ++s)
+                driver = (driver ^ (unsigned char)*s) * 1099511628211ULL;
+    }
+    return (key ^ driver) * 1099511628211ULL;
+}
+
+int fpe_GetProgramBinaryPSA(GLuint program, uint64_t key)
+{
+    if(!psa)
+        return 0;
+    khint_t k = kh_get(prgbinlist, psa->programs, driver_key(key));
+    if(k==kh_end(psa->programs))
+        return 0; // not here
+    prgbin_t *p = kh_value(psa->programs, k);
+    return gl4es_useProgramBinary(program, p->size, p->format, p->prog);
+}
+
+void fpe_AddProgramBinaryPSA(GLuint program, uint64_t key)
+{
+    if(!psa)
+        return;
+    prgbin_t *p = (prgbin_t*)calloc(1, sizeof(prgbin_t));
+    p->key = driver_key(key);
+    int l = gl4es_getProgramBinary(program, &p->size, &p->format, &p->prog);
+    if(l==0) { // there was an error...
+        free(p->prog);
+        free(p);
+        return;
+    }
+    psa->dirty = 1;
+    int ret;
+    khint_t k = kh_put(prgbinlist, psa->programs, p->key, &ret);
+    if(!ret) {
+        prgbin_t *p2 = kh_value(psa->programs, k);
+        free(p2->prog);
+        free(p2);
+    }
+    kh_value(psa->programs, k) = p;
+}
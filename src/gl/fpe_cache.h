@@ -44,6 +44,9 @@ void fpe_readPSA();
 void fpe_writePSA();
 int fpe_GetProgramPSA(GLuint program, fpe_state_t* state);
 void fpe_AddProgramPSA(GLuint program, fpe_state_t* state);
+// application programs, by a hash of their converted sources and bindings
+int fpe_GetProgramBinaryPSA(GLuint program, uint64_t key);
+void fpe_AddProgramBinaryPSA(GLuint program, uint64_t key);
 
 #ifdef DO_NOT_FORGET_TO_UNDEF_fpe_state_t 
 #undef fpe_state_t
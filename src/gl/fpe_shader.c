@@ -36,6 +36,40 @@ const char texcoordxy[] = {'x', 'y', 'z', 'w'};
 
 const char* gl4es_alphaRefSource = "uniform float _gl4es_AlphaRef;\n";
 
+// remove the uniform declarations that are never used in the generated shader
+// (a cheap dead code pass, so weak compilers have less to parse and optimize)
+static void fpe_stripUnusedUniforms()
+{
+    char* p = shad;
+    while(p && *p) {
+        char* eol = strchr(p, '\n');
+        if(!strncmp(p, "uniform ", 8)) {
+            char* end = strchr(p, ';');
+            if(end && (!eol || end<eol)) {
+                // last identifier before the ';', skipping an array size
+                char* e = end;
+                if(e[-1]==']')
+                    while(e>p && *e!='[') --e;
+                char* b = e;
+                while(b>p && b[-1]!=' ') --b;
+                char name[100];
+                int l = e-b;
+                if(l>0 && l<(int)sizeof(name)) {
+                    memcpy(name, b, l);
+                    name[l] = '\0';
+                    if(gl4es_count_string(shad, name)==1) {
+                        // only the declaration, remove the whole line
+                        char* next = eol?(eol+1):(p+strlen(p));
+                        memmove(p, next, strlen(next)+1);
+                        continue;
+                    }
+                }
+            }
+        }
+        p = eol?(eol+1):NULL;
+    }
+}
+
 const char* fpe_texenvSrc(int src, int tmu, int twosided) {
     static char buff[200];
     switch(src) {
@@ -153,6 +187,343 @@ char* fpe_binary(int x, int s) {
 }
     
 
+// Lighting structures and uniforms, in the vertex shader (or in the fragment shader with per fragment lighting)
+static int fpe_lightingHeaders(fpe_state_t *state, int twosided, int color_material) {
+    char buff[1024];
+    int headers = 0;
+    int cm_front_nullexp = state->cm_front_nullexp;
+    int cm_back_nullexp = state->cm_back_nullexp;
+    sprintf(buff, 
+        "struct _gl4es_FPELightSourceParameters1\n"
+        "{\n"
+        "%s"
+        "   highp vec4 specular;\n"
+        "   highp vec4 position;\n"
+        "   highp vec3 spotDirection;\n"
+        "   highp float spotExponent;\n"
+        "   highp float spotCosCutoff;\n"
+        "   highp float constantAttenuation;\n"
+        "   highp float linearAttenuation;\n"
+        "   highp float quadraticAttenuation;\n"
+        "};\n", 
+        (color_material)?
+        "   highp vec4 ambient;\n"
+        "   highp vec4 diffuse;\n"
+        : ""
+        );
+    ShadAppend(buff);
+    headers += gl4es_countline(buff);
+    sprintf(buff, 
+        "struct _gl4es_FPELightSourceParameters0\n"
+        "{\n"
+        "%s"
+        "   highp vec4 specular;\n"
+        "   highp vec4 position;\n"
+        "   highp vec3 spotDirection;\n"
+        "   highp float spotExponent;\n"
+        "   highp float spotCosCutoff;\n"
+        "};\n", 
+        (color_material)?
+        "   highp vec4 ambient;\n"
+        "   highp vec4 diffuse;\n"
+        : ""
+        );
+    ShadAppend(buff);
+    headers += gl4es_countline(buff);
+
+    sprintf(buff,
+            "struct _gl4es_LightProducts\n"
+            "{\n"
+            "   highp vec4 ambient;\n"
+            "   highp vec4 diffuse;\n"
+            "   highp vec4 specular;\n"
+            "};\n"                
+    );
+    ShadAppend(buff);
+    headers += gl4es_countline(buff);
+
+    // shininess is only used if the specular exponent is not null (and not taken from gl_Color)
+    if(cm_front_nullexp && !color_material) {
+        ShadAppend("uniform highp float _gl4es_FrontMaterial_shininess;\n");
+        headers++;
+    }
+    if(twosided && cm_back_nullexp && !color_material) {
+        ShadAppend("uniform highp float _gl4es_BackMaterial_shininess;\n");
+        headers++;
+    }
+    if(!(color_material && (state->cm_front_mode==FPE_CM_DIFFUSE || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))) {
+        ShadAppend("uniform highp float _gl4es_FrontMaterial_alpha;\n");
+        headers++;
+        if(twosided) {
+            ShadAppend("uniform highp float _gl4es_BackMaterial_alpha;\n");
+            headers++;
+        }
+    }
+    for(int i=0; i<hardext.maxlights; i++) {
+        if(state->light&(1<<i)) {
+            sprintf(buff, "uniform _gl4es_FPELightSourceParameters%d _gl4es_LightSource_%d;\n", (state->light_direction>>i&1)?1:0, i);
+            ShadAppend(buff);
+            headers++;
+
+            sprintf(buff, "uniform _gl4es_LightProducts _gl4es_FrontLightProduct_%d;\n", i);
+            ShadAppend(buff);
+            headers++;
+
+            if(twosided) {
+                sprintf(buff, "uniform _gl4es_LightProducts _gl4es_BackLightProduct_%d;\n", i);
+                ShadAppend(buff);
+                headers++;
+            }
+        }
+    }
+    return headers;
+}
+
+// The lighting equation, writing Color, BackColor, SecColor and SecBackColor.
+// color is the primary color used by color material, return need_vertex
+static int fpe_lighting(fpe_state_t *state, int twosided, int color_material, const char* color) {
+    char buff[1024];
+    int need_vertex = 0;
+    int cm_front_nullexp = state->cm_front_nullexp;
+    int ambient_only = (state->light_mode==FPE_LIGHT_AMBIENT);
+    if(comments) {
+        sprintf(buff, "// ColorMaterial On/Off=%d Front = %d Back = %d\n", color_material, state->cm_front_mode, state->cm_back_mode);
+        ShadAppend(buff);
+    }
+    // material emission
+    char fm_emission[60], fm_ambient[60], fm_diffuse[60], fm_specular[60];
+    char bm_emission[60], bm_ambient[60], bm_diffuse[60], bm_specular[60];
+    char cm_light[60];
+    sprintf(cm_light, "%s.xyz * _gl4es_LightSource_", color);
+    sprintf(fm_emission, "%s", (color_material && state->cm_front_mode==FPE_CM_EMISSION)?color:"gl_FrontMaterial.emission");
+    sprintf(fm_ambient, "%s", (color_material && (state->cm_front_mode==FPE_CM_AMBIENT || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))?color:"gl_FrontMaterial.ambient");
+    sprintf(fm_diffuse, "%s", (color_material && (state->cm_front_mode==FPE_CM_DIFFUSE || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))?cm_light:"_gl4es_FrontLightProduct_");
+    sprintf(fm_specular, "%s", (color_material && state->cm_front_mode==FPE_CM_SPECULAR)?cm_light:"_gl4es_FrontLightProduct_");
+    if(twosided) {
+        sprintf(bm_emission, "%s", (color_material && state->cm_back_mode==FPE_CM_EMISSION)?color:"gl_BackMaterial.emission");
+        sprintf(bm_ambient, "%s", (color_material && (state->cm_back_mode==FPE_CM_AMBIENT || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE))?color:"gl_BackMaterial.ambient");
+        sprintf(bm_diffuse, "%s", (color_material && (state->cm_back_mode==FPE_CM_DIFFUSE || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE))?cm_light:"_gl4es_BackLightProduct_");
+        sprintf(bm_specular, "%s", (color_material && state->cm_back_mode==FPE_CM_SPECULAR)?cm_light:"_gl4es_BackLightProduct_");
+    }
+
+    if(color_material && 
+        (state->cm_front_mode==FPE_CM_EMISSION 
+        || state->cm_front_mode==FPE_CM_AMBIENT
+        || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE
+        || (twosided && 
+            (state->cm_back_mode==FPE_CM_EMISSION || state->cm_back_mode==FPE_CM_AMBIENT || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE)))) 
+    {
+        sprintf(buff, "Color = %s;\n", fm_emission);
+        ShadAppend(buff);
+        if(twosided) {
+            sprintf(buff, "BackColor = %s;\n", bm_emission);
+            ShadAppend(buff);
+        }
+        
+        sprintf(buff, "Color += %s*gl_LightModel.ambient;\n", fm_ambient);
+        ShadAppend(buff);
+        if(twosided) {
+            sprintf(buff, "BackColor += %s*gl_LightModel.ambient;\n", bm_ambient);
+            ShadAppend(buff);
+        }
+    } else {
+        ShadAppend("Color = gl_FrontLightModelProduct.sceneColor;\n");
+        if(twosided) {
+            ShadAppend("BackColor = gl_BackLightModelProduct.sceneColor;\n");
+        }
+    }
+    if(state->light_separate) {
+        ShadAppend("SecColor=vec4(0.);\n");
+        if(twosided)
+            ShadAppend("SecBackColor=vec4(0.);\n");
+    }
+    if(ambient_only) {
+        // lights reduced to their ambient term: no normal, no vertex, no attenuation
+        for(int i=0; i<hardext.maxlights; i++) {
+            if(state->light&(1<<i)) {
+                if(color_material && (state->cm_front_mode==FPE_CM_AMBIENT || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))
+                    sprintf(buff, "Color.rgb += %s.xyz * _gl4es_LightSource_%d.ambient.xyz;\n", fm_ambient, i);
+                else
+                    sprintf(buff, "Color.rgb += _gl4es_FrontLightProduct_%d.ambient.xyz;\n", i);
+                ShadAppend(buff);
+                if(twosided) {
+                    if(color_material && (state->cm_back_mode==FPE_CM_AMBIENT || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE))
+                        sprintf(buff, "BackColor.rgb += %s.xyz * _gl4es_LightSource_%d.ambient.xyz;\n", bm_ambient, i);
+                    else
+                        sprintf(buff, "BackColor.rgb += _gl4es_BackLightProduct_%d.ambient.xyz;\n", i);
+                    ShadAppend(buff);
+                }
+            }
+        }
+    } else {
+        // att and spot are only needed for positional or spot lights
+        int need_att = 0, need_spot = 0;
+        for(int i=0; i<hardext.maxlights; i++) {
+            if(state->light&(1<<i)) {
+                if(state->light_direction>>i&1) need_att = 1;
+                if(state->light_cutoff180>>i&1) need_att = need_spot = 1;
+            }
+        }
+        if(need_att)
+            ShadAppend("highp float att;\n");
+        if(need_spot)
+            ShadAppend("highp float spot;\n");
+        ShadAppend("highp vec3 VP;\n");
+        ShadAppend("highp float lVP;\n");
+        ShadAppend("highp float nVP;\n");
+        ShadAppend("highp vec3 aa,dd,ss;\n");
+        ShadAppend("highp vec3 hi;\n");
+        if(twosided)
+            ShadAppend("highp vec3 back_aa,back_dd,back_ss;\n");
+        for(int i=0; i<hardext.maxlights; i++) {
+            if(state->light&(1<<i)) {
+                if(comments) {
+                    sprintf(buff, "// light %d on, light_direction=%d, light_cutoff180=%d\n", i, (state->light_direction>>i&1), (state->light_cutoff180>>i&1));
+                    ShadAppend(buff);
+                }
+                // enabled light i
+                // att depend on light position w, and is folded away for directional lights without spot
+                const char* att = ((state->light_direction>>i&1) || (state->light_cutoff180>>i&1))?"att*":"";
+                if((state->light_direction>>i&1)==0) { // flag is 1 if light is has w!=0
+                    if(att[0])
+                        ShadAppend("att = 1.0;\n");
+                    sprintf(buff, "VP = normalize(_gl4es_LightSource_%d.position.xyz);\n", i);
+                    ShadAppend(buff);
+                } else {
+                    sprintf(buff, "VP = _gl4es_LightSource_%d.position.xyz - vertex.xyz;\n", i);
+                    ShadAppend(buff);
+                    ShadAppend("lVP = length(VP);\n");
+                    sprintf(buff, "att = 1.0/(_gl4es_LightSource_%d.constantAttenuation + lVP*(_gl4es_LightSource_%d.linearAttenuation + _gl4es_LightSource_%d.quadraticAttenuation * lVP));\n", i, i, i);
+                    ShadAppend(buff);
+                    ShadAppend("VP = normalize(VP);\n");
+                    if(!need_vertex) need_vertex=1;
+                }
+                // spot depend on spotlight cutoff angle
+                if((state->light_cutoff180>>i&1)==0) {
+                    //ShadAppend("spot = 1.0;\n");
+                } else {
+                    /*if((state->light_direction>>i&1)==0) {
+                        sprintf(buff, "spot = max(dot(-normalize(vertex.xyz), _gl4es_LightSource_%d.spotDirection), 0.);\n", i);
+                        if(!need_vertex) need_vertex=1;
+                    } else*/ {
+                        sprintf(buff, "spot = max(dot(-VP, _gl4es_LightSource_%d.spotDirection), 0.);\n", i);
+                    }
+                    ShadAppend(buff);
+                    sprintf(buff, "if(spot<_gl4es_LightSource_%d.spotCosCutoff) spot=0.0; else spot=pow(spot, _gl4es_LightSource_%d.spotExponent);\n", i, i);
+                    ShadAppend(buff);
+                    ShadAppend("att *= spot;\n");
+                }
+                if(color_material && (state->cm_front_mode==FPE_CM_AMBIENT || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE)) {
+                    sprintf(buff, "aa = %s.xyz * _gl4es_LightSource_%d.ambient.xyz;\n", fm_ambient, i);
+                    ShadAppend(buff);
+                } else {
+                    sprintf(buff, "aa = _gl4es_FrontLightProduct_%d.ambient.xyz;\n", i);
+                    ShadAppend(buff);
+                }
+                if(twosided) {
+                    if(color_material && (state->cm_back_mode==FPE_CM_AMBIENT || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE)) {
+                        sprintf(buff, "back_aa = %s.xyz * _gl4es_LightSource_%d.ambient.xyz;\n", bm_ambient, i);
+                        ShadAppend(buff);
+                    } else {
+                        sprintf(buff, "back_aa = _gl4es_BackLightProduct_%d.ambient.xyz;\n", i);
+                        ShadAppend(buff);
+                    }                        
+                }
+                sprintf(buff, "nVP = dot(normal, VP);\n");
+                ShadAppend(buff);
+                sprintf(buff, "dd = (nVP>0.)?(nVP * %s%d.diffuse.xyz):vec3(0.);\n", fm_diffuse, i);
+                ShadAppend(buff);
+                if(twosided) {
+                    sprintf(buff, "back_dd = (nVP<0.)?(-nVP * %s%d.diffuse.xyz):vec3(0.);\n", bm_diffuse, i);
+                    ShadAppend(buff);
+                }
+                if(state->light_localviewer) {
+                    ShadAppend("hi = normalize(VP + normalize(-vertex.xyz));\n");
+                    if(!need_vertex) need_vertex=1;
+                } else {
+                    ShadAppend("hi = normalize(VP + vec3(0., 0., 1.));\n");
+                }
+                ShadAppend("lVP = dot(normal, hi);\n");
+                if(cm_front_nullexp)
+                    sprintf(buff, "ss = (nVP>0. && lVP>0.)?(pow(lVP, %s)*%s%d.specular.xyz):vec3(0.);\n", (color_material)?"gl_FrontMaterial.shininess":"_gl4es_FrontMaterial_shininess", fm_specular, i);
+                else
+                    sprintf(buff, "ss = (nVP>0. && lVP>0.)?(%s%d.specular.xyz):vec3(0.);\n", fm_specular, i);
+                ShadAppend(buff);
+                if(twosided) {
+                    if(state->cm_back_nullexp)    // 1, exp is not null
+                        sprintf(buff, "back_ss = (nVP<0. && lVP<0.)?(pow(-lVP, %s)*%s%d.specular.xyz):vec3(0.);\n", (color_material)?"gl_BackMaterial.shininess":"_gl4es_BackMaterial_shininess", bm_specular, i);
+                    else
+                        sprintf(buff, "back_ss = (nVP<0. && lVP<0.)?(%s%d.specular.xyz):vec3(0.);\n", bm_specular, i);
+                    ShadAppend(buff);
+                }
+                if(state->light_separate) {
+                    sprintf(buff, "Color.rgb += %s(aa+dd);\n", att);
+                    ShadAppend(buff);
+                    sprintf(buff, "SecColor.rgb += %s(ss);\n", att);
+                    ShadAppend(buff);
+                    if(twosided) {
+                        sprintf(buff, "BackColor.rgb += %s(back_aa+back_dd);\n", att);
+                        ShadAppend(buff);
+                        sprintf(buff, "SecBackColor.rgb += %s(back_ss);\n", att);
+                        ShadAppend(buff);
+                    }
+                } else {
+                    sprintf(buff, "Color.rgb += %s(aa+dd+ss);\n", att);
+                    ShadAppend(buff);
+                    if(twosided) {
+                        sprintf(buff, "BackColor.rgb += %s(back_aa+back_dd+back_ss);\n", att);
+                        ShadAppend(buff);
+                    }
+                }
+                if(comments) {
+                    sprintf(buff, "// end of light %d\n", i);
+                    ShadAppend(buff);
+                }
+            }
+        }
+    }
+    if(color_material && (state->cm_front_mode==FPE_CM_DIFFUSE || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))
+        sprintf(buff, "Color.a = %s.a;\n", color);
+    else
+        sprintf(buff, "Color.a = _gl4es_FrontMaterial_alpha;\n");
+    ShadAppend(buff);
+    ShadAppend("Color.rgb = clamp(Color.rgb, 0., 1.);\n");
+    if(twosided) {
+        if(color_material && (state->cm_back_mode==FPE_CM_DIFFUSE || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE))
+            sprintf(buff, "BackColor.a = %s.a;\n", color);
+        else
+            sprintf(buff, "BackColor.a = _gl4es_BackMaterial_alpha;\n");
+        ShadAppend("BackColor.rgb = clamp(BackColor.rgb, 0., 1.);\n");
+        ShadAppend(buff);
+    }
+    if(state->light_separate) {
+        ShadAppend("SecColor.rgb = clamp(SecColor.rgb, 0., 1.);\n");
+        if(twosided) {
+            ShadAppend("SecBackColor.rgb = clamp(SecBackColor.rgb, 0., 1.);\n");
+        }
+    }
+    return need_vertex;
+}
+
+// Per fragment lighting: the vertex shader only pass the eye space normal (and vertex, and color for color material)
+static int fpe_fragLightingNeedVertex(fpe_state_t *state) {
+    return state->light_direction || state->light_localviewer;
+}
+
+static int fpe_fragLightingVaryings(fpe_state_t *state, int color_material) {
+    int headers = 1;
+    ShadAppend("varying highp vec3 fpe_normal;\n");
+    if(fpe_fragLightingNeedVertex(state)) {
+        ShadAppend("varying highp vec4 fpe_vertex;\n");
+        headers++;
+    }
+    if(color_material) {
+        ShadAppend("varying vec4 RawColor;\n");
+        headers++;
+    }
+    return headers;
+}
+
 const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state) {
     // vertex is first called, so 1st time init is only here
     if(!shad_cap) shad_cap = 1024;
@@ -172,6 +543,7 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
     int fogdist = state->fogdist;
     int fogmode = state->fogmode;
     int color_material = state->color_material && lighting;
+    int frag_lighting = lighting && !need && state->light_mode==FPE_LIGHT_FRAGMENT;
     int point = state->point;
     int pointsprite = state->pointsprite;
     int headers = 0;
@@ -181,14 +553,13 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
     int need_eyeplane[MAX_TEX][4] = {0};
     int need_objplane[MAX_TEX][4] = {0};
     int need_adjust[MAX_TEX] = {0};
-    int need_lightproduct[2][MAX_LIGHT] = {0};
-    int cm_front_nullexp = state->cm_front_nullexp;
-    int cm_back_nullexp = state->cm_back_nullexp;
     int texgens = 0;
     int texmats = 0;
     const char* fogp = hardext.highp?"highp":"mediump";
 
     for (int i=0; i<hardext.maxtex; ++i) {
+        if(!need && point && !pointsprite)
+            break;  // no texture coordinates at all
         if(state->texgen[i].texgen_s || state->texgen[i].texgen_t || state->texgen[i].texgen_r || state->texgen[i].texgen_q)
             texgens = 1;
         if(state->texture[i].texmat)
@@ -211,7 +582,7 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
             headers+=gl4es_countline(buff);
         }
     }
-    if(!is_default) {
+    if(!is_default && !frag_lighting) {
         ShadAppend("varying vec4 Color;\n");  // might be unused...
         headers++;
     }
@@ -227,91 +598,12 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
             }
         }
     }
-    if(lighting) {
-        sprintf(buff, 
-            "struct _gl4es_FPELightSourceParameters1\n"
-            "{\n"
-            "%s"
-            "   highp vec4 specular;\n"
-            "   highp vec4 position;\n"
-            "   highp vec3 spotDirection;\n"
-            "   highp float spotExponent;\n"
-            "   highp float spotCosCutoff;\n"
-            "   highp float constantAttenuation;\n"
-            "   highp float linearAttenuation;\n"
-            "   highp float quadraticAttenuation;\n"
-            "};\n", 
-            (color_material)?
-            "   highp vec4 ambient;\n"
-            "   highp vec4 diffuse;\n"
-            : ""
-            );
-        ShadAppend(buff);
-        headers += gl4es_countline(buff);
-        sprintf(buff, 
-            "struct _gl4es_FPELightSourceParameters0\n"
-            "{\n"
-            "%s"
-            "   highp vec4 specular;\n"
-            "   highp vec4 position;\n"
-            "   highp vec3 spotDirection;\n"
-            "   highp float spotExponent;\n"
-            "   highp float spotCosCutoff;\n"
-            "};\n", 
-            (color_material)?
-            "   highp vec4 ambient;\n"
-            "   highp vec4 diffuse;\n"
-            : ""
-            );
-        ShadAppend(buff);
-        headers += gl4es_countline(buff);
-
-        sprintf(buff,
-                "struct _gl4es_LightProducts\n"
-                "{\n"
-                "   highp vec4 ambient;\n"
-                "   highp vec4 diffuse;\n"
-                "   highp vec4 specular;\n"
-                "};\n"                
-        );
-        ShadAppend(buff);
-        headers += gl4es_countline(buff);
-
-        if(!(cm_front_nullexp && color_material)) {
-            ShadAppend("uniform highp float _gl4es_FrontMaterial_shininess;\n");
-            headers++;
-        }
-        if(twosided && !(cm_back_nullexp && color_material)) {
-            ShadAppend("uniform highp float _gl4es_BackMaterial_shininess;\n");
-            headers++;
-        }
-        if(!(color_material && (state->cm_front_mode==FPE_CM_DIFFUSE || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))) {
-            ShadAppend("uniform highp float _gl4es_FrontMaterial_alpha;\n");
-            headers++;
-            if(twosided) {
-                ShadAppend("uniform highp float _gl4es_BackMaterial_alpha;\n");
-                headers++;
-            }
-        }
-        for(int i=0; i<hardext.maxlights; i++) {
-            if(state->light&(1<<i)) {
-                sprintf(buff, "uniform _gl4es_FPELightSourceParameters%d _gl4es_LightSource_%d;\n", (state->light_direction>>i&1)?1:0, i);
-                ShadAppend(buff);
-                headers++;
-
-                sprintf(buff, "uniform _gl4es_LightProducts _gl4es_FrontLightProduct_%d;\n", i);
-                ShadAppend(buff);
-                headers++;
-
-                if(twosided) {
-                    sprintf(buff, "uniform _gl4es_LightProducts _gl4es_BackLightProduct_%d;\n", i);
-                    ShadAppend(buff);
-                    headers++;
-                }
-            }
-        }
+    if(frag_lighting) {
+        headers += fpe_fragLightingVaryings(state, color_material);
+    } else if(lighting) {
+        headers += fpe_lightingHeaders(state, twosided, color_material);
     }
-    if(!is_default) {
+    if(!is_default && !frag_lighting) {
         if(twosided) {
             ShadAppend("varying vec4 BackColor;\n");
             headers++;
@@ -349,6 +641,8 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
     // textures coordinates
     for (int i=0; i<hardext.maxtex; i++) {
         int t = state->texture[i].textype;
+        if(point && !pointsprite)
+            t = 0;  // not read by the fragment shader
         if(need)
             t = (need->need_texs&(1<<i))?1:0;
         if(t) {
@@ -396,11 +690,17 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
                 ShadAppend("SecColor = gl_SecondaryColor;\n");
             }
         }
-    } else {
-        if(comments) {
-            sprintf(buff, "// ColorMaterial On/Off=%d Front = %d Back = %d\n", color_material, state->cm_front_mode, state->cm_back_mode);
-            ShadAppend(buff);
+    } else if(frag_lighting) {
+        // lighting is done in the fragment shader, only pass its inputs
+        need_normal = 1;
+        ShadAppend("fpe_normal = normal;\n");
+        if(fpe_fragLightingNeedVertex(state)) {
+            if(!need_vertex) need_vertex = 1;
+            ShadAppend("fpe_vertex = vertex;\n");
         }
+        if(color_material)
+            ShadAppend("RawColor = gl_Color;\n");
+    } else {
         if(is_default && need) {
             ShadAppend("vec4 Color;\n");
             if(twosided)
@@ -410,176 +710,10 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
             if(secondary && twosided)
                 ShadAppend("vec4 SecBackColor\n");
         }
-        // material emission
-        char fm_emission[60], fm_ambient[60], fm_diffuse[60], fm_specular[60];
-        char bm_emission[60], bm_ambient[60], bm_diffuse[60], bm_specular[60];
-        sprintf(fm_emission, "%s", (color_material && state->cm_front_mode==FPE_CM_EMISSION)?"gl_Color":"gl_FrontMaterial.emission");
-        sprintf(fm_ambient, "%s", (color_material && (state->cm_front_mode==FPE_CM_AMBIENT || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))?"gl_Color":"gl_FrontMaterial.ambient");
-        sprintf(fm_diffuse, "%s", (color_material && (state->cm_front_mode==FPE_CM_DIFFUSE || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))?"gl_Color.xyz * _gl4es_LightSource_":"_gl4es_FrontLightProduct_");
-        sprintf(fm_specular, "%s", (color_material && state->cm_front_mode==FPE_CM_SPECULAR)?"gl_Color.xyz * _gl4es_LightSource_":"_gl4es_FrontLightProduct_");
-        if(twosided) {
-            sprintf(bm_emission, "%s", (color_material && state->cm_back_mode==FPE_CM_EMISSION)?"gl_Color":"gl_BackMaterial.emission");
-            sprintf(bm_ambient, "%s", (color_material && (state->cm_back_mode==FPE_CM_AMBIENT || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE))?"gl_Color":"gl_BackMaterial.ambient");
-            sprintf(bm_diffuse, "%s", (color_material && (state->cm_back_mode==FPE_CM_DIFFUSE || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE))?"gl_Color.xyz * _gl4es_LightSource_":"_gl4es_BackLightProduct_");
-            sprintf(bm_specular, "%s", (color_material && state->cm_back_mode==FPE_CM_SPECULAR)?"gl_Color.xyz * _gl4es_LightSource_":"_gl4es_BackLightProduct_");
-        }
-
-        if(color_material && 
-            (state->cm_front_mode==FPE_CM_EMISSION 
-            || state->cm_front_mode==FPE_CM_AMBIENT
-            || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE
-            || (twosided && 
-                (state->cm_back_mode==FPE_CM_EMISSION || state->cm_back_mode==FPE_CM_AMBIENT || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE)))) 
-        {
-            sprintf(buff, "Color = %s;\n", fm_emission);
-            ShadAppend(buff);
-            if(twosided) {
-                sprintf(buff, "BackColor = %s;\n", bm_emission);
-                ShadAppend(buff);
-            }
-            
-            sprintf(buff, "Color += %s*gl_LightModel.ambient;\n", fm_ambient);
-            ShadAppend(buff);
-            if(twosided) {
-                sprintf(buff, "BackColor += %s*gl_LightModel.ambient;\n", bm_ambient);
-                ShadAppend(buff);
-            }
-        } else {
-            ShadAppend("Color = gl_FrontLightModelProduct.sceneColor;\n");
-            if(twosided) {
-                ShadAppend("BackColor = gl_BackLightModelProduct.sceneColor;\n");
-            }
-        }
-        if(light_separate) {
-            ShadAppend("SecColor=vec4(0.);\n");
-            if(twosided)
-                ShadAppend("SecBackColor=vec4(0.);\n");
-        }
-        ShadAppend("highp float att;\n");
-        ShadAppend("highp float spot;\n");
-        ShadAppend("highp vec3 VP;\n");
-        ShadAppend("highp float lVP;\n");
-        ShadAppend("highp float nVP;\n");
-        ShadAppend("highp vec3 aa,dd,ss;\n");
-        ShadAppend("highp vec3 hi;\n");
-        if(twosided)
-            ShadAppend("highp vec3 back_aa,back_dd,back_ss;\n");
-        need_normal = 1;
-        for(int i=0; i<hardext.maxlights; i++) {
-            if(state->light&(1<<i)) {
-                if(comments) {
-                    sprintf(buff, "// light %d on, light_direction=%d, light_cutoff180=%d\n", i, (state->light_direction>>i&1), (state->light_cutoff180>>i&1));
-                    ShadAppend(buff);
-                }
-                // enabled light i
-                // att depend on light position w
-                if((state->light_direction>>i&1)==0) { // flag is 1 if light is has w!=0
-                    ShadAppend("att = 1.0;\n");
-                    sprintf(buff, "VP = normalize(_gl4es_LightSource_%d.position.xyz);\n", i);
-                    ShadAppend(buff);
-                } else {
-                    sprintf(buff, "VP = _gl4es_LightSource_%d.position.xyz - vertex.xyz;\n", i);
-                    ShadAppend(buff);
-                    ShadAppend("lVP = length(VP);\n");
-                    sprintf(buff, "att = 1.0/(_gl4es_LightSource_%d.constantAttenuation + lVP*(_gl4es_LightSource_%d.linearAttenuation + _gl4es_LightSource_%d.quadraticAttenuation * lVP));\n", i, i, i);
-                    ShadAppend(buff);
-                    ShadAppend("VP = normalize(VP);\n");
-                    if(!need_vertex) need_vertex=1;
-                }
-                // spot depend on spotlight cutoff angle
-                if((state->light_cutoff180>>i&1)==0) {
-                    //ShadAppend("spot = 1.0;\n");
-                } else {
-                    /*if((state->light_direction>>i&1)==0) {
-                        sprintf(buff, "spot = max(dot(-normalize(vertex.xyz), _gl4es_LightSource_%d.spotDirection), 0.);\n", i);
-                        if(!need_vertex) need_vertex=1;
-                    } else*/ {
-                        sprintf(buff, "spot = max(dot(-VP, _gl4es_LightSource_%d.spotDirection), 0.);\n", i);
-                    }
-                    ShadAppend(buff);
-                    sprintf(buff, "if(spot<_gl4es_LightSource_%d.spotCosCutoff) spot=0.0; else spot=pow(spot, _gl4es_LightSource_%d.spotExponent);\n", i, i);
-                    ShadAppend(buff);
-                    ShadAppend("att *= spot;\n");
-                }
-                if(color_material && (state->cm_front_mode==FPE_CM_AMBIENT || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE)) {
-                    sprintf(buff, "aa = %s.xyz * _gl4es_LightSource_%d.ambient.xyz;\n", fm_ambient, i);
-                    ShadAppend(buff);
-                } else {
-                    sprintf(buff, "aa = _gl4es_FrontLightProduct_%d.ambient.xyz;\n", i);
-                    ShadAppend(buff);
-                    need_lightproduct[0][i] = 1;
-                }
-                if(twosided) {
-                    if(color_material && (state->cm_back_mode==FPE_CM_AMBIENT || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE)) {
-                        sprintf(buff, "back_aa = %s.xyz * _gl4es_LightSource_%d.ambient.xyz;\n", bm_ambient, i);
-                        ShadAppend(buff);
-                    } else {
-                        sprintf(buff, "back_aa = _gl4es_BackLightProduct_%d.ambient.xyz;\n", i);
-                        ShadAppend(buff);
-                        need_lightproduct[1][i] = 1;                     
-                    }                        
-                }
-                sprintf(buff, "nVP = dot(normal, VP);\n");
-                ShadAppend(buff);
-                sprintf(buff, "dd = (nVP>0.)?(nVP * %s%d.diffuse.xyz):vec3(0.);\n", fm_diffuse, i);
-                ShadAppend(buff);
-                need_lightproduct[0][i] = 1;
-                if(twosided) {
-                    sprintf(buff, "back_dd = (nVP<0.)?(-nVP * %s%d.diffuse.xyz):vec3(0.);\n", bm_diffuse, i);
-                    ShadAppend(buff);
-                    need_lightproduct[1][i] = 1;
-                }
-                if(state->light_localviewer) {
-                    ShadAppend("hi = normalize(VP + normalize(-vertex.xyz));\n");
-                    if(!need_vertex) need_vertex=1;
-                } else {
-                    ShadAppend("hi = normalize(VP + vec3(0., 0., 1.));\n");
-                }
-                ShadAppend("lVP = dot(normal, hi);\n");
-                if(cm_front_nullexp)
-                    sprintf(buff, "ss = (nVP>0. && lVP>0.)?(pow(lVP, %s)*%s%d.specular.xyz):vec3(0.);\n", (color_material)?"gl_FrontMaterial.shininess":"_gl4es_FrontMaterial_shininess", fm_specular, i);
-                else
-                    sprintf(buff, "ss = (nVP>0. && lVP>0.)?(%s%d.specular.xyz):vec3(0.);\n", fm_specular, i);
-                ShadAppend(buff);
-                if(twosided) {
-                    if(state->cm_back_nullexp)    // 1, exp is not null
-                        sprintf(buff, "back_ss = (nVP<0. && lVP<0.)?(pow(-lVP, %s)*%s%d.specular.xyz):vec3(0.);\n", (color_material)?"gl_BackMaterial.shininess":"_gl4es_BackMaterial_shininess", bm_specular, i);
-                    else
-                        sprintf(buff, "back_ss = (nVP<0. && lVP<0.)?(%s%d.specular.xyz):vec3(0.);\n", bm_specular, i);
-                    ShadAppend(buff);
-                }
-                if(state->light_separate) {
-                    ShadAppend("Color.rgb += att*(aa+dd);\n");
-                    ShadAppend("SecColor.rgb += att*(ss);\n");
-                    if(twosided) {
-                        ShadAppend("BackColor.rgb += att*(back_aa+back_dd);\n");
-                        ShadAppend("SecBackColor.rgb += att*(back_ss);\n");
-                    }
-                } else {
-                    ShadAppend("Color.rgb += att*(aa+dd+ss);\n");
-                    if(twosided)
-                        ShadAppend("BackColor.rgb += att*(back_aa+back_dd+back_ss);\n");
-                }
-                if(comments) {
-                    sprintf(buff, "// end of light %d\n", i);
-                    ShadAppend(buff);
-                }
-            }
-        }
-        sprintf(buff, "Color.a = %s;\n", (color_material && (state->cm_front_mode==FPE_CM_DIFFUSE || state->cm_front_mode==FPE_CM_AMBIENTDIFFUSE))?"gl_Color.a":"_gl4es_FrontMaterial_alpha");
-        ShadAppend(buff);
-        ShadAppend("Color.rgb = clamp(Color.rgb, 0., 1.);\n");
-        if(twosided) {
-            sprintf(buff, "BackColor.a = %s;\n", (color_material && (state->cm_back_mode==FPE_CM_DIFFUSE || state->cm_back_mode==FPE_CM_AMBIENTDIFFUSE))?"gl_Color.a":"_gl4es_BackMaterial_alpha");
-            ShadAppend("BackColor.rgb = clamp(BackColor.rgb, 0., 1.);\n");
-            ShadAppend(buff);
-        }
-        if(state->light_separate) {
-            ShadAppend("SecColor.rgb = clamp(SecColor.rgb, 0., 1.);\n");
-            if(twosided) {
-                ShadAppend("SecBackColor.rgb = clamp(SecBackColor.rgb, 0., 1.);\n");
-            }
-        }
+        if(fpe_lighting(state, twosided, color_material, "gl_Color") && !need_vertex)
+            need_vertex = 1;
+        if(state->light_mode!=FPE_LIGHT_AMBIENT)
+            need_normal = 1;
         if(is_default && need) {
             if(need->need_color>0)
                 ShadAppend("gl_FrontColor = Color;\n");
@@ -602,6 +736,8 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
         ShadAppend("vec4 tmp_tex;\n");
     for (int i=0; i<hardext.maxtex; i++) {
         int t = state->texture[i].textype;
+        if(!need && point && !pointsprite)
+            t = 0;
         if(need && (need->need_texs&(1<<i)) && t==0)
             t = 1;
         if(need && !(need->need_texs&(1<<i)))
@@ -807,6 +943,8 @@ const char* const* fpe_VertexShader(shaderconv_need_t* need, fpe_state_t *state)
 
     ShadAppend("}\n");
 
+    fpe_stripUnusedUniforms();
+
     DBG(printf("FPE Shader: \n%s\n", shad);)
 
     return (const char* const*)&shad;
@@ -823,6 +961,8 @@ const char* const* fpe_FragmentShader(shaderconv_need_t* need, fpe_state_t *stat
     int lighting = state->lighting;
     int twosided = state->twosided && lighting;
     int light_separate = state->light_separate && lighting;
+    int color_material = state->color_material && lighting;
+    int frag_lighting = lighting && is_default && state->light_mode==FPE_LIGHT_FRAGMENT;
     int secondary = is_default?((state->colorsum && !(lighting && light_separate)) || fpe_texenvSecondary(state)):need->need_secondary;
     int alpha_test = state->alphatest;
     int alpha_func = state->alphafunc;
@@ -866,19 +1006,24 @@ const char* const* fpe_FragmentShader(shaderconv_need_t* need, fpe_state_t *stat
         ShadAppend(buff);
         headers+=gl4es_countline(buff);
     }
-    ShadAppend("varying vec4 Color;\n");
-    headers++;
-    if(twosided) {
-        ShadAppend("varying vec4 BackColor;\n");
-        headers++;
-    }
-    if(light_separate || secondary) {
-        ShadAppend("varying vec4 SecColor;\n");
+    if(frag_lighting) {
+        headers += fpe_lightingHeaders(state, twosided, color_material);
+        headers += fpe_fragLightingVaryings(state, color_material);
+    } else {
+        ShadAppend("varying vec4 Color;\n");
         headers++;
         if(twosided) {
-            ShadAppend("varying vec4 SecBackColor;\n");
+            ShadAppend("varying vec4 BackColor;\n");
             headers++;
         }
+        if(light_separate || secondary) {
+            ShadAppend("varying vec4 SecColor;\n");
+            headers++;
+            if(twosided) {
+                ShadAppend("varying vec4 SecBackColor;\n");
+                headers++;
+            }
+        }
     }
     if(fog) {
         #if 0   // vertex fog
@@ -958,6 +1103,28 @@ const char* const* fpe_FragmentShader(shaderconv_need_t* need, fpe_state_t *stat
         ShadAppend(")<0.) discard;\n");
     }
 
+    //*** per fragment lighting
+    if(frag_lighting) {
+        ShadAppend("vec4 Color;\n");
+        if(twosided)
+            ShadAppend("vec4 BackColor;\n");
+        if(light_separate || secondary) {
+            ShadAppend("vec4 SecColor;\n");
+            if(twosided)
+                ShadAppend("vec4 SecBackColor;\n");
+            if(!light_separate) {
+                // no separate specular, so secondary color is 0 when lighting
+                ShadAppend("SecColor = vec4(0.);\n");
+                if(twosided)
+                    ShadAppend("SecBackColor = vec4(0.);\n");
+            }
+        }
+        ShadAppend("highp vec3 normal = normalize(fpe_normal);\n");
+        if(fpe_fragLightingNeedVertex(state))
+            ShadAppend("highp vec4 vertex = fpe_vertex;\n");
+        fpe_lighting(state, twosided, color_material, "RawColor");
+    }
+
     //*** initial color
     sprintf(buff, "vec4 fColor = %s;\n", twosided?"(gl_FrontFacing)?Color:BackColor":"Color");
     ShadAppend(buff);
@@ -1624,6 +1791,8 @@ const char* const* fpe_FragmentShader(shaderconv_need_t* need, fpe_state_t *stat
     ShadAppend("gl_FragColor = fColor;\n");
     ShadAppend("}");
 
+    fpe_stripUnusedUniforms();
+
     DBG(printf("FPE Shader: \n%s\n", shad);)
 
     return (const char* const*)&shad;
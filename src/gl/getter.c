@@ -223,6 +223,11 @@ void BuildExtensionsList() {
             "GL_ARB_get_program_binary "
             );
         }
+        if(hardext.parallelcompile) {
+            strcat(extensions,
+            "GL_ARB_parallel_shader_compile "
+            );
+        }
         char *p = extensions;
         glstate->num_extensions = 0;
         // quickly count extensions. Each one is separated by space...
@@ -775,6 +780,9 @@ int gl4es_commonGet(GLenum pname, GLfloat *params) {
         case GL_GAMMA_HINT_GL4ES:
             *params=globals4es.gamma*10.f;
             break;
+        case GL_FPELIGHTING_HINT_GL4ES:
+            *params=globals4es.fpelighting;
+            break;
         default:
             return 0;
     }
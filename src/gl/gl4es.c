@@ -529,6 +529,7 @@ void APIENTRY_GL4ES gl4es_glArrayElement(GLint i) {
     vertexattrib_t *p;
     glvao_t* vao = glstate->vao;
     int stride, size;
+    realize_arrays_shadow(vao);
     p = &vao->vertexattrib[ATT_COLOR];
     if (p->enabled) {
         size = p->size; stride = p->stride;
@@ -650,9 +651,8 @@ void APIENTRY_GL4ES gl4es_glArrayElement(GLint i) {
 AliasExport(void,glArrayElement,,(GLint i));
 AliasExport(void,glArrayElement,EXT,(GLint i));
 
-// TODO: between a lock and unlock, I can assume the array pointers are unchanged
-// so I can build a renderlist_t on the first call and hold onto it
-// maybe I need a way to call a renderlist_t with (first, count)
+// between a lock and unlock, the arrays are unchanged, so with LIBGL_USEVBO=2 or 3
+// the locked range is uploaded once in a VBO on the first draw (see ToBuffer)
 void APIENTRY_GL4ES gl4es_glLockArrays(GLint first, GLsizei count) {
     if(glstate->vao->locked) {
         errorShim(GL_INVALID_OPERATION);
@@ -673,63 +673,64 @@ void APIENTRY_GL4ES gl4es_glUnlockArrays(void) {
 AliasExport(void,glUnlockArrays,EXT,());
 
 void ToBuffer(int first, int count) {
-    // this is hacky. Only the fpe VA should be treated here (but then, the consistancy check is a bit more difficult to do)
     if(count<13)
         return; // no VBO for smallest ones (4 triangles)
     glstate->vao->locked = globals4es.usevbo;
-    // Strategy: compile only VA that are interleaved. So only 1 "Buffer" is compiled. Out of the buffer VA are not compiled
-    // That should works with Quake3 engine that expect only Vertices array to be Compiled, but still allow to build more complex arrays
-    for (int i=0; i<NB_VA; i++)
-        if(glstate->vao->vertexattrib[i].enabled && (!valid_vertex_type(glstate->vao->vertexattrib[i].type) || glstate->vao->vertexattrib[i].real_buffer)) {
-            return;
-        }
-    // try to see if there is a master index....
-    uintptr_t master = (uintptr_t)glstate->vao->vertexattrib[ATT_VERTEX].pointer;
-    int stride = glstate->vao->vertexattrib[ATT_VERTEX].stride;
-    if(stride)
-    for (int i=ATT_VERTEX+1; i<NB_VA; i++) {
-        if(glstate->vao->vertexattrib[i].enabled) {
-            uintptr_t p = (uintptr_t)glstate->vao->vertexattrib[i].pointer;
-            int nstride = glstate->vao->vertexattrib[i].stride;
-            if(stride && stride==nstride) {
-                if ((p>master-stride) && (p<master+stride)) {
-                    if(p<master) master = p;
-                }
+    // Strategy: each enabled array, or group of interleaved arrays, is a "stream". All streams are uploaded once, in the same
+    // buffer, and used by all the draws until glUnlockArrays. Arrays GLES cannot use directly stay on the client side.
+    // That works with Quake3 engine that expect only Vertices array to be Compiled, and with engines that lock all arrays
+    uintptr_t start[NB_VA], end[NB_VA];
+    int sstride[NB_VA], base[NB_VA];
+    int stream[NB_VA];
+    int nstreams = 0;
+    for (int i=0; i<NB_VA; i++) {
+        vertexattrib_t *v = &glstate->vao->vertexattrib[i];
+        stream[i] = -1;
+        if(!v->enabled || v->real_buffer || v->buffer || v->divisor || !v->pointer || v->size==GL_BGRA || !valid_vertex_type(v->type))
+            continue;
+        int elsize = gl_sizeof(v->type)*v->size;
+        int stride = v->stride?v->stride:elsize;
+        uintptr_t p = (uintptr_t)v->pointer;
+        // interleaved with an existing stream?
+        for (int j=0; j<nstreams && stream[i]<0; j++) {
+            uintptr_t s = (p<start[j])?p:start[j];
+            uintptr_t e = (p+elsize>end[j])?(p+elsize):end[j];
+            if(sstride[j]==stride && e-s<=stride) {
+                start[j] = s;
+                end[j] = e;
+                stream[i] = j;
             }
         }
+        if(stream[i]<0) {
+            start[nstreams] = p;
+            end[nstreams] = p+elsize;
+            sstride[nstreams] = stride;
+            stream[i] = nstreams++;
+        }
     }
-    if(!stride) stride = gl_sizeof(glstate->vao->vertexattrib[ATT_VERTEX].type)*glstate->vao->vertexattrib[ATT_VERTEX].size;
     memset(glstate->vao->locked_mapped, 0, sizeof(glstate->vao->locked_mapped));
-    // ok, now we have a "master", let's count the required size
-    int total = stride * count;
-    // now allocate (if needed) the buffer and bind it
-    uintptr_t ptr = 0;
-    // move "master" data if there
-    #if 0
-    LOAD_GLES(glGenBuffers);
-    LOAD_GLES(glBufferData);
-    LOAD_GLES(glBindBuffer);
-    if(!glstate->scratch_vertex)
-        gles_glGenBuffers(1, &glstate->scratch_vertex);
-    glstate->scratch_vertex_size = stride*count;
-    bindBuffer(GL_ARRAY_BUFFER, glstate->scratch_vertex);
-    gles_glBufferData(GL_ARRAY_BUFFER, stride*count, (void*)(master+first*stride), GL_STREAM_DRAW);
-    #else
+    if(!nstreams)
+        return;
+    // ok, now we have the streams, let's count the required size
+    int total = 0;
+    for (int j=0; j<nstreams; j++) {
+        base[j] = total;
+        total += ((count-1)*sstride[j] + (end[j]-start[j]) + 3)&~3;
+    }
     LOAD_GLES(glBufferSubData);
     gl4es_scratch_vertex(total);    // alloc if needed and bind scratch vertex buffer
-    gles_glBufferSubData(GL_ARRAY_BUFFER, ptr, stride*count, (void*)(master+first*stride));
-    #endif
+    for (int j=0; j<nstreams; j++)
+        gles_glBufferSubData(GL_ARRAY_BUFFER, base[j], (count-1)*sstride[j] + (end[j]-start[j]), (void*)(start[j]+first*sstride[j]));
+    // "first" is not uploaded, so the pointers are rebased to keep the indices unchanged
     for (int i=0; i<NB_VA; i++) {
-        if(glstate->vao->vertexattrib[i].enabled) {
-            uintptr_t p = (uintptr_t)glstate->vao->vertexattrib[i].pointer;
-            if(p>=master && p<master+stride) {
-                glstate->vao->vertexattrib[i].real_pointer = (void*)(p-master - first*stride);
-                glstate->vao->vertexattrib[i].real_buffer = glstate->scratch_vertex;
-                glstate->vao->locked_mapped[i] = 1;
-            }
+        if(stream[i]>=0) {
+            const int j = stream[i];
+            glstate->vao->vertexattrib[i].real_pointer = (void*)(base[j] + ((uintptr_t)glstate->vao->vertexattrib[i].pointer-start[j]) - first*sstride[j]);
+            glstate->vao->vertexattrib[i].real_buffer = glstate->scratch_vertex;
+            glstate->vao->locked_mapped[i] = 1;
         }
     }
-//printf("BindBuffers (fist=%d, count=%d) vertex = %p %sx%d (%d)\n", first, count, glstate->vao->vertexattrib[ATT_VERTEX].real_pointer, PrintEnum(glstate->vao->vertexattrib[ATT_VERTEX].type), glstate->vao->vertexattrib[ATT_VERTEX].size, glstate->vao->vertexattrib[ATT_VERTEX].stride);
+    DBG(printf("BindBuffers (fist=%d, count=%d) %d streams, vertex = %p %sx%d (%d)\n", first, count, nstreams, glstate->vao->vertexattrib[ATT_VERTEX].real_pointer, PrintEnum(glstate->vao->vertexattrib[ATT_VERTEX].type), glstate->vao->vertexattrib[ATT_VERTEX].size, glstate->vao->vertexattrib[ATT_VERTEX].stride);)
     // unbind the buffer
     gl4es_use_scratch_vertex(0);
 }
@@ -1210,6 +1211,55 @@ void gl4es_use_scratch_indices(int use) {
     bindBuffer(GL_ELEMENT_ARRAY_BUFFER, use?glstate->scratch_indices:0);
 }
 
+// Shared GL_QUADS -> GL_TRIANGLES indices: 0,1,2, 0,2,3, 4,5,6, 4,6,7...
+// The array only grows, so any prefix of it is valid for a smaller count
+#define QUAD_INDICES_STEP   4096
+#define QUAD_INDICES_MAX    65536
+GLushort* gl4es_quad_indices(int count) {
+    if(count>QUAD_INDICES_MAX)
+        return NULL;
+    if(glstate->quad_indices_cap < count) {
+        int cap = (count+QUAD_INDICES_STEP-1)&~(QUAD_INDICES_STEP-1);
+        GLushort* ind = (GLushort*)realloc(glstate->quad_indices, cap*3/2*sizeof(GLushort));
+        if(!ind)
+            return NULL;
+        for (int i=glstate->quad_indices_cap, j=glstate->quad_indices_cap*3/2; i<cap; i+=4, j+=6) {
+            ind[j+0] = i+0;
+            ind[j+1] = i+1;
+            ind[j+2] = i+2;
+
+            ind[j+3] = i+0;
+            ind[j+4] = i+2;
+            ind[j+5] = i+3;
+        }
+        glstate->quad_indices = ind;
+        glstate->quad_indices_cap = cap;
+    }
+    return glstate->quad_indices;
+}
+#undef QUAD_INDICES_MAX
+#undef QUAD_INDICES_STEP
+
+void gl4es_use_quad_indices() {
+    LOAD_GLES(glBufferData);
+    LOAD_GLES(glGenBuffers);
+    if(!glstate->quad_indices_buffer) {
+        gles_glGenBuffers(1, &glstate->quad_indices_buffer);
+    }
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER, glstate->quad_indices_buffer);
+    if(glstate->quad_indices_size < glstate->quad_indices_cap) {
+        gles_glBufferData(GL_ELEMENT_ARRAY_BUFFER, glstate->quad_indices_cap*3/2*sizeof(GLushort), glstate->quad_indices, GL_STATIC_DRAW);
+        glstate->quad_indices_size = glstate->quad_indices_cap;
+    }
+}
+
+int gl4es_is_quad_indices(const void* indices) {
+    if(!glstate->quad_indices)
+        return 0;
+    const GLushort* ind = (const GLushort*)indices;
+    return (ind>=glstate->quad_indices && ind<glstate->quad_indices+glstate->quad_indices_cap*3/2);
+}
+
 #if defined(AMIGAOS4) || (defined(NOX11) && defined(NOEGL))
 #ifdef AMIGAOS4
 void amiga_pre_swap()
@@ -125,6 +125,9 @@ void gl4es_scratch_vertex(int alloc);
 void gl4es_scratch_indices(int alloc);
 void gl4es_use_scratch_vertex(int use);
 void gl4es_use_scratch_indices(int use);
+GLushort* gl4es_quad_indices(int count);
+void gl4es_use_quad_indices();
+int gl4es_is_quad_indices(const void* indices);
 
 void ToBuffer(int first, int count);
 void UnBuffer();
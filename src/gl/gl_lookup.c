@@ -963,6 +963,9 @@ void* APIENTRY_GL4ES gl4es_GetProcAddress(const char *name) {
     _ARB(glGetProgramBinary);
     _ARB(glProgramBinary);
 
+    //ARB_parallel_shader_compile
+    _ARB(glMaxShaderCompilerThreads);
+
     //ARB_draw_elements_base_vertex / EXT_draw_elements_base_vertex
     _EX(glDrawElementsBaseVertex);
     _EXT(glDrawElementsBaseVertex);
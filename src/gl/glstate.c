@@ -544,6 +544,15 @@ void DeleteGLState(void* oldstate) {
     // scratch buffer
     if(state->scratch)
         free(state->scratch);
+    // shared quad indices
+    if(state->quad_indices)
+        free(state->quad_indices);
+    if(state->quad_indices_buffer) {
+        LOAD_GLES(glDeleteBuffers);
+        gles_glDeleteBuffers(1, &state->quad_indices_buffer);
+        state->quad_indices_buffer = 0;
+    }
+    state->quad_indices_size = 0;
     // merger buffers
     if(state->merger_master)
         free(state->merger_master);
@@ -106,6 +106,11 @@ struct glstate_s {
     GLsizei             scratch_vertex_size;
     GLuint              scratch_indices;
     GLsizei             scratch_indices_size;
+    // shared Quads -> Triangles indices (CPU copy + GLES element buffer)
+    GLushort*           quad_indices;
+    int                 quad_indices_cap;   // in vertices
+    GLuint              quad_indices_buffer;
+    int                 quad_indices_size;  // in vertices, uploaded to quad_indices_buffer
     // Implementation read
     GLenum              readf; // implementation Read Format
     GLenum              readt; // implementation Read Type
@@ -127,6 +127,12 @@ void APIENTRY_GL4ES gl4es_glHint(GLenum pname, GLenum mode) {
             pandora_set_gamma();
 #endif
             break;
+        case GL_FPELIGHTING_HINT_GL4ES:
+            if (mode==0 || mode==2 || (mode==1 && hardext.highp))
+                globals4es.fpelighting = mode;
+            else
+                errorShim(GL_INVALID_ENUM); 
+            break;
         default:
             errorGL();
             gles_glHint(pname, mode);
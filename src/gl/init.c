@@ -10,12 +10,14 @@
 #include "../../version.h"
 #include "../glx/glx_gbm.h"
 #include "../glx/streaming.h"
+#include "buffers.h"
 #include "build_info.h"
 #include "debug.h"
 #include "loader.h"
 #include "logs.h"
 #include "fpe_cache.h"
 #include "init.h"
+#include "shaderconv.h"
 #include "envvars.h"
 #if defined(__EMSCRIPTEN__) || defined(__APPLE__)
 #define NO_INIT_CONSTRUCTOR
@@ -547,6 +549,51 @@ void initialize_gl4es() {
               break;
         }
       }
+    globals4es.vcacheopt = ReturnEnvVarIntDef("LIBGL_VCACHEOPT",0);
+    switch(globals4es.vcacheopt) {
+      case 0:
+        break;
+      case 1:
+        SHUT_LOGD("Vertex cache optimization of Display Lists\n");
+        break;
+      case 2:
+        SHUT_LOGD("Vertex cache optimization of Display Lists (with ACMR log)\n");
+        break;
+      default:
+        globals4es.vcacheopt=0;
+        break;
+    }
+    if(globals4es.usevbo) {
+      globals4es.listcompact = ReturnEnvVarIntDef("LIBGL_LISTCOMPACT",1);
+      if(!globals4es.listcompact)
+        SHUT_LOGD("Compact VBO formats for Display Lists disabled\n");
+      env(LIBGL_NOVBOSHADOW, globals4es.novboshadow, "No CPU copy of static and dynamic VBO (when possible)");
+      env(LIBGL_MAPDIFF, globals4es.mapdiff, "Upload only the modified parts of mapped VBO");
+      globals4es.vboring = ReturnEnvVarIntDef("LIBGL_VBORING",0);
+      if(globals4es.vboring>MAX_RING)
+        globals4es.vboring = MAX_RING;
+      if(globals4es.vboring>1) {
+        SHUT_LOGD("Use a ring of %d VBO for streaming buffers\n", globals4es.vboring);
+      } else
+        globals4es.vboring = 0;
+    }
+    if(hardext.gles3) {
+      env(LIBGL_NOPBO, globals4es.nopbo, "Don't use real PBO for async glReadPixels and texture uploads");
+    }
+    globals4es.listweld = ReturnEnvVarIntDef("LIBGL_LISTWELD",0);
+    switch(globals4es.listweld) {
+      case 0:
+        break;
+      case 1:
+        SHUT_LOGD("Weld identical vertices of Display Lists\n");
+        break;
+      case 2:
+        SHUT_LOGD("Weld identical vertices of Display Lists (with dedup log)\n");
+        break;
+      default:
+        globals4es.listweld=0;
+        break;
+    }
 
     globals4es.fbomakecurrent = 0;
     if((hardext.vendor & VEND_ARM) || (globals4es.usefb))
@@ -629,6 +676,22 @@ void initialize_gl4es() {
     env(LIBGL_SHADERNOGLES, globals4es.shadernogles, "Remove GLES part in shader");
     env(LIBGL_NOES2COMPAT, globals4es.noes2, "Don't expose GLX_EXT_create_context_es2_profile extension");
     env(LIBGL_NORMALIZE, globals4es.normalize, "Force normals to be normalized on FPE shaders");
+    globals4es.fpelighting = ReturnEnvVarIntDef("LIBGL_FPELIGHTING",0);
+    switch(globals4es.fpelighting) {
+        case 1:
+            if(hardext.highp) {
+                SHUT_LOGD("FPE lighting computed per fragment\n");
+                break;
+            }
+            SHUT_LOGD("No highp in fragment shaders, FPE lighting stays per vertex\n");
+            globals4es.fpelighting = 0;
+            break;
+        case 2:
+            SHUT_LOGD("FPE lighting reduced to the ambient terms\n");
+            break;
+        default:
+            globals4es.fpelighting = 0;
+    }
 
     globals4es.dbgshaderconv=ReturnEnvVarIntDef("LIBGL_DBGSHADERCONV",0);
     if(globals4es.dbgshaderconv) {
@@ -738,6 +801,7 @@ void close_gl4es() {
     gl_close();
     fpe_writePSA();
     fpe_FreePSA();
+    FreeShaderConvCache();
         #if defined(GL4ES_COMPILE_FOR_USE_IN_SHARED_LIB) && defined(AMIGAOS4)
         os4CloseLib();
       #endif
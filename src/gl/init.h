@@ -51,6 +51,13 @@ typedef struct _globals4es {
  int es;
  int gl;
  int usevbo;
+ int vcacheopt;
+ int listweld;
+ int listcompact;
+ int novboshadow;
+ int mapdiff;
+ int vboring;
+ int nopbo;
  int comments;
  int forcenpot;
  int fbomakecurrent;    // hack to bind/unbind FBO when doing glXMakeCurrent
@@ -73,6 +80,7 @@ typedef struct _globals4es {
  int noarbprogram;      // to disable ARB Program
  int glxnative;
  int normalize;         // force normal normalization (workaround a bug)
+ int fpelighting;       // FPE lighting: 0=per vertex, 1=per fragment, 2=ambient only
  int blitfb0;
  int skiptexcopies;
  int shaderblend;
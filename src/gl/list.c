@@ -255,6 +255,12 @@ void renderlist_quads2triangles(renderlist_t *a) {
     } else
         a->indices = (GLushort*)malloc(ilen*sizeof(GLushort));
 
+    GLushort *quads = (ind)?NULL:gl4es_quad_indices(len);
+    if(quads) {
+        // plain Quads, use the precomputed indices (so the shared VBO can be used too)
+        memcpy(a->indices, quads, ilen*sizeof(GLushort));
+        a->quad_indices = 1;
+    } else
     for (int i=0, j=0; i+3<len; i+=4, j+=6) {
         a->indices[j+0] = vind(i+0);
         a->indices[j+1] = vind(i+1);
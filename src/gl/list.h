@@ -137,6 +137,12 @@ typedef struct {
     int    ilen;
 } modeinit_t;
 
+typedef struct {
+    GLenum  type;       // 0 if the VBO copy use the same layout as the list array
+    GLint   size;
+    int     normalized;
+} vboformat_t;
+
 typedef struct _renderlist_t {
     unsigned long len;
     unsigned long ilen;
@@ -175,13 +181,19 @@ typedef struct _renderlist_t {
     GLuint   vbo_array;
     GLuint   vbo_indices;
     int      use_vbo_array;   // 0=Not evaluated, 1=No, 2=Yes
-    int      use_vbo_indices; // same
+    int      use_vbo_indices; // same, 3=Yes using the shared Quads indices VBO
+    int      quad_indices;    // indices are a copy of the shared Quads -> Triangles ones
+    int      optimized;       // one time optimisations of compiled lists done
     GLfloat *vbo_vert;
     GLfloat *vbo_normal;
     GLfloat *vbo_color;
     GLfloat *vbo_secondary;
     GLfloat *vbo_fogcoord;
     GLfloat *vbo_tex[MAX_TEX];
+    vboformat_t vbo_vert_fmt;
+    vboformat_t vbo_color_fmt;
+    vboformat_t vbo_secondary_fmt;
+    vboformat_t vbo_tex_fmt[MAX_TEX];
     int *shared_indices;
     GLushort *indices;
     unsigned int indice_cap;
@@ -1,10 +1,14 @@
 #include "list.h"
 
+#include <math.h>
+
 #include "../glx/hardext.h"
 #include "wrap/gl4es.h"
+#include "enum_info.h"
 #include "fpe.h"
 #include "init.h"
 #include "line.h"
+#include "listopt.h"
 #include "loader.h"
 #include "matrix.h"
 #include "texgen.h"
@@ -18,8 +22,84 @@ typedef struct array2vbo_s {
     uint32_t    stride;
     uintptr_t   vbo_base;
     uintptr_t   vbo_basebase;
+    void*       compact;        // packed copy of the array in a smaller format
+    uint32_t    compact_size;
 } array2vbo_t;
 
+// Compact VBO formats, only used if they don't lose anything
+static void* compact_color(const GLfloat* src, int stride, int len, vboformat_t* fmt) {
+    if(!stride) stride = 4*sizeof(GLfloat);
+    GLubyte* dst = (GLubyte*)malloc(len*4);
+    for (int i=0; i<len; ++i) {
+        const GLfloat* c = (const GLfloat*)((const char*)src+i*stride);
+        for (int k=0; k<4; ++k) {
+            GLfloat u = floorf(c[k]*255.0f+0.5f);
+            // allow float rounding noise from the many ubyte->float conversions
+            if(c[k]<0.0f || c[k]>1.0f || fabsf(u/255.0f-c[k])>1e-6f) {
+                free(dst);
+                return NULL;
+            }
+            dst[i*4+k] = (GLubyte)u;
+        }
+    }
+    fmt->type = GL_UNSIGNED_BYTE;
+    fmt->size = 4;
+    fmt->normalized = 1;
+    return dst;
+}
+
+static int half_exact(GLfloat f, GLushort* h) {
+    union { GLfloat f; uint32_t u; } v;
+    v.f = f;
+    uint32_t sign = (v.u>>16)&0x8000;
+    int exp = (int)((v.u>>23)&0xff) - 127;
+    uint32_t mant = v.u&0x7fffff;
+    if(!(v.u&0x7fffffff)) {
+        *h = sign;
+        return 1;
+    }
+    if(exp<-14 || exp>15 || (mant&0x1fff))
+        return 0;
+    *h = sign | ((exp+15)<<10) | (mant>>13);
+    return 1;
+}
+
+// vertex and texcoords: drop the unused (default) components, and use half float if possible
+static void* compact_coords(const GLfloat* src, int stride, int len, int texcoord, vboformat_t* fmt) {
+    if(!stride) stride = 4*sizeof(GLfloat);
+    int size = texcoord?2:3;
+    for (int i=0; i<len && size<4; ++i) {
+        const GLfloat* c = (const GLfloat*)((const char*)src+i*stride);
+        if(c[3]!=1.0f) size = 4;
+        else if(c[2]!=0.0f && texcoord) size = 3;
+    }
+    int half = (texcoord && hardext.gles3);  // GL_HALF_FLOAT attributes are core in GLES 3.0
+    if(half) {
+        GLushort* dst = (GLushort*)malloc(len*size*sizeof(GLushort));
+        for (int i=0; i<len && half; ++i) {
+            const GLfloat* c = (const GLfloat*)((const char*)src+i*stride);
+            for (int k=0; k<size && half; ++k)
+                half = half_exact(c[k], dst+i*size+k);
+        }
+        if(half) {
+            fmt->type = GL_HALF_FLOAT;
+            fmt->size = size;
+            fmt->normalized = 0;
+            return dst;
+        }
+        free(dst);
+    }
+    if(size==4)
+        return NULL;
+    GLfloat* dst = (GLfloat*)malloc(len*size*sizeof(GLfloat));
+    for (int i=0; i<len; ++i)
+        memcpy(dst+i*size, (const char*)src+i*stride, size*sizeof(GLfloat));
+    fmt->type = GL_FLOAT;
+    fmt->size = size;
+    fmt->normalized = 0;
+    return dst;
+}
+
 int list2VBO(renderlist_t* list)
 {
     LOAD_GLES2(glGenBuffers);
@@ -29,11 +109,15 @@ int list2VBO(renderlist_t* list)
     // list -> work
     int imax = 0;
     int len = list->len;
+    #define COMPACT(F) if(work[imax].compact) {work[imax].compact_size = len*F.size*gl_sizeof(F.type); work[imax].real_size = 0;}
     if(list->vert) {
         work[imax].real_base = (uintptr_t)list->vert;
         work[imax].stride = list->vert_stride;
         if(!work[imax].stride) work[imax].stride = 4*4; // 4*GL_FLOAT
         work[imax].real_size = work[imax].stride*len;
+        if(globals4es.listcompact)
+            work[imax].compact = compact_coords(list->vert, list->vert_stride, len, 0, &list->vbo_vert_fmt);
+        COMPACT(list->vbo_vert_fmt);
         imax++;
     }
     if(list->color) {
@@ -41,6 +125,9 @@ int list2VBO(renderlist_t* list)
         work[imax].stride = list->color_stride;
         if(!work[imax].stride) work[imax].stride = 4*4; // 4*GL_FLOAT
         work[imax].real_size = work[imax].stride*len;
+        if(globals4es.listcompact)
+            work[imax].compact = compact_color(list->color, list->color_stride, len, &list->vbo_color_fmt);
+        COMPACT(list->vbo_color_fmt);
         imax++;
     }
     if(list->secondary) {
@@ -48,6 +135,9 @@ int list2VBO(renderlist_t* list)
         work[imax].stride = list->secondary_stride;
         if(!work[imax].stride) work[imax].stride = 4*4; // 4*GL_FLOAT
         work[imax].real_size = work[imax].stride*len;
+        if(globals4es.listcompact)
+            work[imax].compact = compact_color(list->secondary, list->secondary_stride, len, &list->vbo_secondary_fmt);
+        COMPACT(list->vbo_secondary_fmt);
         imax++;
     }
     if(list->fogcoord) {
@@ -70,9 +160,13 @@ int list2VBO(renderlist_t* list)
             work[imax].stride = list->tex_stride[a];
             if(!work[imax].stride) work[imax].stride = 4*4; // 4*GL_FLOAT
             work[imax].real_size = work[imax].stride*len;
+            if(globals4es.listcompact)
+                work[imax].compact = compact_coords(list->tex[a], list->tex_stride[a], len, 1, &list->vbo_tex_fmt[a]);
+            COMPACT(list->vbo_tex_fmt[a]);
             imax++;
         }
     }
+    #undef COMPACT
     // sort the real address...
     int sorted[ATT_MAX];
     for (int i=0; i<imax; ++i)
@@ -104,6 +198,15 @@ int list2VBO(renderlist_t* list)
         if(base == basebase)
             vbo_base += r->real_size;
     }
+    // compacted arrays go at the end
+    for (int i=0; i<imax; ++i) {
+        array2vbo_t *r = work+i;
+        if(r->compact) {
+            vbo_base = (vbo_base+3)&~3;
+            r->vbo_base = r->vbo_basebase = vbo_base;
+            vbo_base += r->compact_size;
+        }
+    }
     if(!vbo_base)   // no data?!
         return 1;
     // Create the VBO and fill the data
@@ -112,7 +215,10 @@ int list2VBO(renderlist_t* list)
     gles_glBufferData(GL_ARRAY_BUFFER, vbo_base, NULL, GL_STATIC_DRAW);
     for(int i=0; i<imax; ++i) {
         array2vbo_t *r = work+sorted[i];
-        if(r->vbo_base==r->vbo_basebase)
+        if(r->compact) {
+            gles_glBufferSubData(GL_ARRAY_BUFFER, r->vbo_basebase, r->compact_size, r->compact);
+            free(r->compact);
+        } else if(r->vbo_base==r->vbo_basebase)
             gles_glBufferSubData(GL_ARRAY_BUFFER, r->vbo_basebase, r->real_size, (void*)r->real_base);
     }
     // work -> list
@@ -150,8 +256,33 @@ typedef struct save_vbo_s {
     GLuint          real_buffer;
     const GLvoid*   real_pointer;
     glbuffer_t*     buffer;
+    GLint           size;
+    GLenum          type;
+    GLsizei         stride;
+    int             normalized;
 } save_vbo_t;
 
+static void activeVBOFormat(vertexattrib_t* va, vboformat_t* fmt, save_vbo_t* saved) {
+    if(!fmt->type)
+        return;
+    saved->size = va->size;
+    saved->type = va->type;
+    saved->stride = va->stride;
+    saved->normalized = va->normalized;
+    va->size = fmt->size;
+    va->type = fmt->type;
+    va->stride = 0;
+    va->normalized = fmt->normalized;
+}
+static void inactiveVBOFormat(vertexattrib_t* va, vboformat_t* fmt, save_vbo_t* saved) {
+    if(!fmt->type)
+        return;
+    va->size = saved->size;
+    va->type = saved->type;
+    va->stride = saved->stride;
+    va->normalized = saved->normalized;
+}
+
 void listActiveVBO(renderlist_t* list, save_vbo_t* saved) {
     if(list->vert) {
         saved[ATT_VERTEX].real_buffer = glstate->vao->vertexattrib[ATT_VERTEX].real_buffer;
@@ -160,6 +291,7 @@ void listActiveVBO(renderlist_t* list, save_vbo_t* saved) {
         glstate->vao->vertexattrib[ATT_VERTEX].real_buffer = list->vbo_array;
         glstate->vao->vertexattrib[ATT_VERTEX].real_pointer = list->vbo_vert;
         glstate->vao->vertexattrib[ATT_VERTEX].buffer = NULL;
+        activeVBOFormat(&glstate->vao->vertexattrib[ATT_VERTEX], &list->vbo_vert_fmt, &saved[ATT_VERTEX]);
     }
     if(list->color) {
         saved[ATT_COLOR].real_buffer = glstate->vao->vertexattrib[ATT_COLOR].real_buffer;
@@ -168,6 +300,7 @@ void listActiveVBO(renderlist_t* list, save_vbo_t* saved) {
         glstate->vao->vertexattrib[ATT_COLOR].real_buffer = list->vbo_array;
         glstate->vao->vertexattrib[ATT_COLOR].real_pointer = list->vbo_color;
         glstate->vao->vertexattrib[ATT_COLOR].buffer = NULL;
+        activeVBOFormat(&glstate->vao->vertexattrib[ATT_COLOR], &list->vbo_color_fmt, &saved[ATT_COLOR]);
     }
     if(list->secondary) {
         saved[ATT_SECONDARY].real_buffer = glstate->vao->vertexattrib[ATT_SECONDARY].real_buffer;
@@ -176,6 +309,7 @@ void listActiveVBO(renderlist_t* list, save_vbo_t* saved) {
         glstate->vao->vertexattrib[ATT_SECONDARY].real_buffer = list->vbo_array;
         glstate->vao->vertexattrib[ATT_SECONDARY].real_pointer = list->vbo_secondary;
         glstate->vao->vertexattrib[ATT_SECONDARY].buffer = NULL;
+        activeVBOFormat(&glstate->vao->vertexattrib[ATT_SECONDARY], &list->vbo_secondary_fmt, &saved[ATT_SECONDARY]);
     }
     if(list->fogcoord) {
         saved[ATT_FOGCOORD].real_buffer = glstate->vao->vertexattrib[ATT_FOGCOORD].real_buffer;
@@ -201,6 +335,7 @@ void listActiveVBO(renderlist_t* list, save_vbo_t* saved) {
             glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+a].real_buffer = list->vbo_array;
             glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+a].real_pointer = list->vbo_tex[a];
             glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+a].buffer = NULL;
+            activeVBOFormat(&glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+a], &list->vbo_tex_fmt[a], &saved[ATT_MULTITEXCOORD0+a]);
         }
     }
 }
@@ -209,16 +344,19 @@ void listInactiveVBO(renderlist_t* list, save_vbo_t* saved) {
         glstate->vao->vertexattrib[ATT_VERTEX].real_buffer = saved[ATT_VERTEX].real_buffer;
         glstate->vao->vertexattrib[ATT_VERTEX].real_pointer = saved[ATT_VERTEX].real_pointer;
         glstate->vao->vertexattrib[ATT_VERTEX].buffer = saved[ATT_VERTEX].buffer;
+        inactiveVBOFormat(&glstate->vao->vertexattrib[ATT_VERTEX], &list->vbo_vert_fmt, &saved[ATT_VERTEX]);
     }
     if(list->color) {
         glstate->vao->vertexattrib[ATT_COLOR].real_buffer = saved[ATT_COLOR].real_buffer;
         glstate->vao->vertexattrib[ATT_COLOR].real_pointer = saved[ATT_COLOR].real_pointer;
         glstate->vao->vertexattrib[ATT_COLOR].buffer = saved[ATT_COLOR].buffer;
+        inactiveVBOFormat(&glstate->vao->vertexattrib[ATT_COLOR], &list->vbo_color_fmt, &saved[ATT_COLOR]);
     }
     if(list->secondary) {
         glstate->vao->vertexattrib[ATT_SECONDARY].real_buffer = saved[ATT_SECONDARY].real_buffer;
         glstate->vao->vertexattrib[ATT_SECONDARY].real_pointer = saved[ATT_SECONDARY].real_pointer;
         glstate->vao->vertexattrib[ATT_SECONDARY].buffer = saved[ATT_SECONDARY].buffer;
+        inactiveVBOFormat(&glstate->vao->vertexattrib[ATT_SECONDARY], &list->vbo_secondary_fmt, &saved[ATT_SECONDARY]);
     }
     if(list->fogcoord) {
         glstate->vao->vertexattrib[ATT_FOGCOORD].real_buffer = saved[ATT_FOGCOORD].real_buffer;
@@ -235,6 +373,7 @@ void listInactiveVBO(renderlist_t* list, save_vbo_t* saved) {
             glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+a].real_buffer = saved[ATT_MULTITEXCOORD0+a].real_buffer;
             glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+a].real_pointer = saved[ATT_MULTITEXCOORD0+a].real_pointer;
             glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+a].buffer = saved[ATT_MULTITEXCOORD0+a].buffer;
+            inactiveVBOFormat(&glstate->vao->vertexattrib[ATT_MULTITEXCOORD0+a], &list->vbo_tex_fmt[a], &saved[ATT_MULTITEXCOORD0+a]);
         }
     }
 }
@@ -395,6 +534,8 @@ void draw_renderlist(renderlist_t *list) {
         // close if needed!
         if (list->open)
             list = end_renderlist(list);
+        if (list->name && !list->optimized)
+            optimize_renderlist(list);
         // push/pop attributes
         if (list->pushattribute)
             gl4es_glPushAttrib(list->pushattribute);
@@ -526,6 +667,9 @@ void draw_renderlist(renderlist_t *list) {
             use_vbo_array = 1;
         }
         int use_vbo_indices = list->use_vbo_indices;
+        if(!use_vbo_indices && list->quad_indices && hardext.esversion>1 && globals4es.usevbo) {
+            use_vbo_indices = 3;
+        }
         if(!use_vbo_indices &&  (hardext.esversion==1 || globals4es.usevbo==0 || !list->name)) {
             use_vbo_indices = 1;
         }
@@ -764,6 +908,9 @@ void draw_renderlist(renderlist_t *list) {
                     } else if(use_vbo_indices==2) {
                         bindBuffer(GL_ELEMENT_ARRAY_BUFFER, list->vbo_indices);
                         vbo_indices = 1;
+                    } else if(use_vbo_indices==3) {
+                        gl4es_use_quad_indices();
+                        vbo_indices = 1;
                     } else
                         realize_bufferIndex();
                     if(list->instanceCount==1)
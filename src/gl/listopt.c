@@ -0,0 +1,329 @@
+#include "listopt.h"
+
+#include <math.h>
+
+#include "const.h"
+#include "init.h"
+#include "logs.h"
+
+//#define DEBUG
+#ifdef DEBUG
+#define DBG(a) a
+#else
+#define DBG(a)
+#endif
+
+#define VCACHE_SIZE     32  // LRU cache size used for the vertex scoring
+#define VCACHE_FIFO     16  // FIFO cache size used to measure ACMR
+
+float renderlist_acmr(const GLushort *indices, int ilen, int len) {
+    if(ilen<3)
+        return 0.0f;
+    int *stamp = (int*)malloc(len*sizeof(int));
+    for (int i=0; i<len; ++i)
+        stamp[i] = -VCACHE_FIFO-1;
+    int time = 0;
+    int misses = 0;
+    for (int i=0; i<ilen; ++i) {
+        GLushort v = indices[i];
+        if(time-stamp[v] >= VCACHE_FIFO) {
+            stamp[v] = time++;
+            ++misses;
+        }
+    }
+    free(stamp);
+    return (float)misses/(float)(ilen/3);
+}
+
+// Tom Forsyth "Linear-Speed Vertex Cache Optimisation" scoring
+static float vcache_score(int pos, int remaining) {
+    if(!remaining)
+        return -1.0f;
+    float score = 0.0f;
+    if(pos>=0) {
+        if(pos<3)
+            score = 0.75f;  // vertices of the last triangle, fixed score to not favor strips too much
+        else
+            score = powf(1.0f-(float)(pos-3)/(float)(VCACHE_SIZE-3), 1.5f);
+    }
+    return score + 2.0f/sqrtf((float)remaining);
+}
+
+// reorder the primitives of prim indices (3 for triangles, 6 for the 2 triangles of a quad, kept together)
+static void vcache_optimize(GLushort *indices, int ilen, int len, int prim) {
+    int ntri = ilen/prim;
+    int *tri_count = (int*)calloc(len, sizeof(int));
+    int *adj_start = (int*)malloc((len+1)*sizeof(int));
+    int *adj = (int*)malloc(ntri*prim*sizeof(int));
+    int *cache_pos = (int*)malloc(len*sizeof(int));
+    float *vscore = (float*)malloc(len*sizeof(float));
+    char *tdone = (char*)calloc(ntri, 1);
+    GLushort *out = (GLushort*)malloc(ntri*prim*sizeof(GLushort));
+    int cache[VCACHE_SIZE+6];
+    int cache_len = 0;
+    // vertex -> primitives adjacency
+    for (int i=0; i<ntri*prim; ++i)
+        tri_count[indices[i]]++;
+    adj_start[0] = 0;
+    for (int v=0; v<len; ++v)
+        adj_start[v+1] = adj_start[v] + tri_count[v];
+    for (int v=0; v<len; ++v)
+        cache_pos[v] = adj_start[v];
+    for (int i=0; i<ntri*prim; ++i)
+        adj[cache_pos[indices[i]]++] = i/prim;
+    for (int v=0; v<len; ++v) {
+        cache_pos[v] = -1;
+        vscore[v] = vcache_score(-1, tri_count[v]);
+    }
+    int best = -1;
+    int cursor = 0;
+    for (int n=0; n<ntri; ++n) {
+        if(best<0) {
+            // nothing usable in the cache, restart from the next triangle in submission order
+            while(tdone[cursor]) ++cursor;
+            best = cursor;
+        }
+        const int t = best;
+        const GLushort *tri = indices+t*prim;
+        tdone[t] = 1;
+        memcpy(out+n*prim, tri, prim*sizeof(GLushort));
+        for (int k=0; k<prim; ++k) {
+            int v = tri[k];
+            int *a = adj+adj_start[v];
+            int c = tri_count[v];
+            for (int i=0; i<c; ++i)
+                if(a[i]==t) {
+                    a[i] = a[c-1];
+                    break;
+                }
+            tri_count[v]--;
+        }
+        // primitive vertices go in front of the cache
+        int newcache[VCACHE_SIZE+6];
+        int nl = 0;
+        for (int k=0; k<prim; ++k) {
+            int found = 0;
+            for (int i=0; i<nl; ++i)
+                if(newcache[i]==tri[k]) found = 1;
+            if(!found)
+                newcache[nl++] = tri[k];
+        }
+        const int np = nl;
+        for (int i=0; i<cache_len; ++i) {
+            int found = 0;
+            for (int k=0; k<np; ++k)
+                if(cache[i]==newcache[k]) found = 1;
+            if(!found)
+                newcache[nl++] = cache[i];
+        }
+        for (int i=0; i<nl; ++i) {
+            int v = newcache[i];
+            cache_pos[v] = (i<VCACHE_SIZE)?i:-1;
+            vscore[v] = vcache_score(cache_pos[v], tri_count[v]);
+        }
+        cache_len = (nl<VCACHE_SIZE)?nl:VCACHE_SIZE;
+        memcpy(cache, newcache, cache_len*sizeof(int));
+        // best next triangle among the ones using a vertex in the cache
+        best = -1;
+        float best_score = -1.0f;
+        for (int i=0; i<nl; ++i) {
+            int v = newcache[i];
+            const int *a = adj+adj_start[v];
+            for (int j=0; j<tri_count[v]; ++j) {
+                const GLushort *t2 = indices+a[j]*prim;
+                float s = 0.0f;
+                for (int k=0; k<prim; ++k)
+                    s += vscore[t2[k]];
+                if(s>best_score) {
+                    best_score = s;
+                    best = a[j];
+                }
+            }
+        }
+    }
+    memcpy(indices, out, ntri*prim*sizeof(GLushort));
+    free(out);
+    free(tdone);
+    free(vscore);
+    free(cache_pos);
+    free(adj);
+    free(adj_start);
+    free(tri_count);
+}
+
+#define LIST_ARRAYS (5+MAX_TEX)
+// gather the vertex arrays of a list, return 0 if some are aliased (so cannot be changed in place)
+static int list_arrays(renderlist_t *list, GLfloat **arrays, int *strides, int *sizes) {
+    arrays[0] = list->vert;      strides[0] = list->vert_stride;      sizes[0] = 4;
+    arrays[1] = list->color;     strides[1] = list->color_stride;     sizes[1] = 4;
+    arrays[2] = list->secondary; strides[2] = list->secondary_stride; sizes[2] = 4;
+    arrays[3] = list->fogcoord;  strides[3] = list->fogcoord_stride;  sizes[3] = 1;
+    arrays[4] = list->normal;    strides[4] = list->normal_stride;    sizes[4] = 3;
+    for (int a=0; a<MAX_TEX; ++a) {
+        arrays[5+a] = (a<list->maxtex)?list->tex[a]:NULL;
+        strides[5+a] = list->tex_stride[a];
+        sizes[5+a] = 4;
+    }
+    for (int i=0; i<LIST_ARRAYS; ++i) {
+        if(!strides[i]) strides[i] = sizes[i]*sizeof(GLfloat);
+        for (int j=0; j<i; ++j)
+            if(arrays[i] && arrays[i]==arrays[j])
+                return 0;
+    }
+    return 1;
+}
+
+static void permute_array(GLfloat *array, int stride, int size, const int *remap, int len, GLfloat *tmp) {
+    for (int v=0; v<len; ++v)
+        memcpy(tmp+remap[v]*size, (char*)array+v*stride, size*sizeof(GLfloat));
+    for (int v=0; v<len; ++v)
+        memcpy((char*)array+v*stride, tmp+v*size, size*sizeof(GLfloat));
+}
+
+// reorder the vertices in the order of first use by the indices
+static void vfetch_optimize(renderlist_t *list) {
+    GLfloat *arrays[LIST_ARRAYS];
+    int strides[LIST_ARRAYS], sizes[LIST_ARRAYS];
+    if(!list_arrays(list, arrays, strides, sizes))
+        return;
+    int len = list->len;
+    int *remap = (int*)malloc(len*sizeof(int));
+    for (int v=0; v<len; ++v)
+        remap[v] = -1;
+    int next = 0;
+    for (int i=0; i<list->ilen; ++i)
+        if(remap[list->indices[i]]<0)
+            remap[list->indices[i]] = next++;
+    for (int v=0; v<len; ++v)
+        if(remap[v]<0)
+            remap[v] = next++;
+    GLfloat *tmp = (GLfloat*)malloc(len*4*sizeof(GLfloat));
+    for (int i=0; i<LIST_ARRAYS; ++i)
+        if(arrays[i])
+            permute_array(arrays[i], strides[i], sizes[i], remap, len, tmp);
+    free(tmp);
+    for (int i=0; i<list->ilen; ++i)
+        list->indices[i] = remap[list->indices[i]];
+    free(remap);
+}
+
+static int weld_compatible(renderlist_t *list) {
+    if(!list->len || list->len>65536 || list->use_glstate || list->shared_arrays || list->shared_indices)
+        return 0;
+    // line primitives need their own vertices for the stipple coordinates
+    if(list->mode_inits) {
+        for (int i=0; i<list->mode_init_len; ++i)
+            if(list->mode_inits[i].mode_init<GL_TRIANGLES)
+                return 0;
+    } else if(list->mode_init<GL_TRIANGLES)
+        return 0;
+    return 1;
+}
+
+static uint32_t weld_hash(GLfloat **arrays, const int *strides, const int *sizes, int v) {
+    uint32_t hash = 2166136261u;    // FNV-1a
+    for (int i=0; i<LIST_ARRAYS; ++i)
+        if(arrays[i]) {
+            const unsigned char *p = (const unsigned char*)arrays[i]+v*strides[i];
+            for (int k=0; k<sizes[i]*(int)sizeof(GLfloat); ++k)
+                hash = (hash^p[k])*16777619u;
+        }
+    return hash;
+}
+
+static int weld_equal(GLfloat **arrays, const int *strides, const int *sizes, int a, int b) {
+    for (int i=0; i<LIST_ARRAYS; ++i)
+        if(arrays[i] && memcmp((char*)arrays[i]+a*strides[i], (char*)arrays[i]+b*strides[i], sizes[i]*sizeof(GLfloat)))
+            return 0;
+    return 1;
+}
+
+// merge identical vertices (all attributes equal), the list becomes indexed
+static void weld_vertices(renderlist_t *list) {
+    GLfloat *arrays[LIST_ARRAYS];
+    int strides[LIST_ARRAYS], sizes[LIST_ARRAYS];
+    if(!list_arrays(list, arrays, strides, sizes))
+        return;
+    int len = list->len;
+    int hsize = 1;
+    while(hsize<len*2) hsize<<=1;
+    int *table = (int*)malloc(hsize*sizeof(int));
+    for (int i=0; i<hsize; ++i)
+        table[i] = -1;
+    int *remap = (int*)malloc(len*sizeof(int));
+    int next = 0;
+    for (int v=0; v<len; ++v) {
+        uint32_t h = weld_hash(arrays, strides, sizes, v)&(hsize-1);
+        while(table[h]>=0 && !weld_equal(arrays, strides, sizes, table[h], v))
+            h = (h+1)&(hsize-1);
+        if(table[h]<0) {
+            // new unique vertex, compact it in place (next<=v)
+            if(next!=v)
+                for (int i=0; i<LIST_ARRAYS; ++i)
+                    if(arrays[i])
+                        memcpy((char*)arrays[i]+next*strides[i], (char*)arrays[i]+v*strides[i], sizes[i]*sizeof(GLfloat));
+            table[h] = next;
+            remap[v] = next++;
+        } else
+            remap[v] = table[h];
+    }
+    free(table);
+    if(next<len) {
+        if(globals4es.listweld==2)
+            LOGD("Display List %u: %d vertices welded to %d (%.1f%%)\n", list->name, len, next, next*100.0f/len);
+        if(list->indices) {
+            for (int i=0; i<list->ilen; ++i)
+                list->indices[i] = remap[list->indices[i]];
+        } else {
+            list->indices = (GLushort*)malloc(len*sizeof(GLushort));
+            for (int i=0; i<len; ++i)
+                list->indices[i] = remap[i];
+            list->ilen = len;
+            list->indice_cap = len;
+        }
+        list->len = next;
+        list->quad_indices = 0;
+    }
+    free(remap);
+}
+
+// size of the primitives that can be reordered (0 if the list cannot be)
+static int vcache_compatible(renderlist_t *list) {
+    if(list->mode!=GL_TRIANGLES || !list->indices || list->ilen<6 || list->use_glstate)
+        return 0;
+    // plain Quads don't share any vertex, nothing to gain (welded ones are not plain anymore)
+    if(list->quad_indices)
+        return 0;
+    if(list->shared_indices)
+        return 0;
+    // triangles order is needed to rebuild the edges of other primitives in GL_LINE mode,
+    // so Quads are moved as a whole (their 2 triangles are 6 consecutive indices)
+    GLenum mode_init = list->mode_inits?list->mode_inits[0].mode_init:list->mode_init;
+    if(mode_init!=GL_TRIANGLES && mode_init!=GL_QUADS)
+        return 0;
+    for (int i=1; list->mode_inits && i<list->mode_init_len; ++i)
+        if(list->mode_inits[i].mode_init!=mode_init)
+            return 0;
+    if(mode_init==GL_QUADS)
+        return (list->ilen%6)?0:6;
+    return 3;
+}
+
+void optimize_renderlist(renderlist_t *list) {
+    list->optimized = 1;
+    if(globals4es.listweld && weld_compatible(list))
+        weld_vertices(list);
+    int prim = globals4es.vcacheopt?vcache_compatible(list):0;
+    if(prim) {
+        float before = (globals4es.vcacheopt==2)?renderlist_acmr(list->indices, list->ilen, list->len):0.0f;
+        vcache_optimize(list->indices, list->ilen, list->len, prim);
+        if(!list->shared_arrays)
+            vfetch_optimize(list);
+        if(list->ind_lines) {
+            free(list->ind_lines);
+            list->ind_lines = NULL;
+        }
+        if(globals4es.vcacheopt==2)
+            LOGD("Display List %u: %lu triangles, ACMR %.3f -> %.3f\n", list->name, list->ilen/3, before, renderlist_acmr(list->indices, list->ilen, list->len));
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef _GL4ES_LISTOPT_H_
+#define _GL4ES_LISTOPT_H_
+
+#include "list.h"
+
+// one time optimisations of compiled Display Lists, done on first draw
+void optimize_renderlist(renderlist_t *list);
+// Average Cache Miss Ratio of a GL_TRIANGLES indices list
+float renderlist_acmr(const GLushort *indices, int ilen, int len);
+
+#endif // _GL4ES_LISTOPT_H_
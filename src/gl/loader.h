@@ -62,6 +62,9 @@ typedef void (*glEndQueryEXT_PTR)(GLenum target);
 typedef void (*glGetQueryivEXT_PTR)(GLenum target, GLenum pname, GLint *params);
 typedef void (*glGetQueryObjectuivEXT_PTR)(GLuint id, GLenum pname, GLuint *params);
 
+// KHR_parallel_shader_compile function pointer
+typedef void (*glMaxShaderCompilerThreads_PTR)(GLuint count);
+
 typedef NativePixmapType (*egl_create_pixmap_ID_mapping_PTR)(void *pixmap);
 typedef NativePixmapType (*egl_destroy_pixmap_ID_mapping_PTR)(int id);
 #ifdef TEXSTREAM
@@ -236,6 +239,12 @@ EXPORT extern void *egl;
         LOAD_RAW(gles, name, proc_address(gles, #name"EXT")); \
     }
 
+#define LOAD_GLES_KHR(name) \
+    DEFINE_RAW(gles, name); \
+    { \
+        LOAD_RAW(gles, name, proc_address(gles, #name"KHR")); \
+    }
+
 #define LOAD_GLES2_OR_OES(name) \
     DEFINE_RAW(gles, name); \
     { \
@@ -262,6 +271,13 @@ EXPORT extern void *egl;
         LOAD_RAW(gles, name, egl_eglGetProcAddress(#name"EXT")); \
     }
 
+#define LOAD_GLES_KHR(name) \
+    DEFINE_RAW(gles, name); \
+    { \
+        LOAD_EGL(eglGetProcAddress); \
+        LOAD_RAW(gles, name, egl_eglGetProcAddress(#name"KHR")); \
+    }
+
 #define LOAD_GLES2_OR_OES(name) \
     DEFINE_RAW(gles, name); \
     { \
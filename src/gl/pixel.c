@@ -1041,6 +1041,38 @@ bool pixel_convert(const GLvoid *src, GLvoid **dst,
         }
         return true;
     }
+    // RGBA / BGRA -> A
+    if (((src_format == GL_RGBA)||(src_format == GL_BGRA)) && (dst_format == GL_ALPHA) && (dst_type == GL_UNSIGNED_BYTE) && ((src_type == GL_UNSIGNED_BYTE))) {
+        for (int i = 0; i < height; i++) {
+			for (int j = 0; j < width; j++) {
+				((char*)dst_pos)[0] = ((char*)src_pos)[3];
+				src_pos += src_stride;
+				dst_pos += dst_stride;
+			}
+			dst_pos += dst_width;
+            src_pos += src_widthadj;
+        }
+        return true;
+    }
+    // RGBA / BGRA -> RGBA float
+    if (((src_format == GL_RGBA)||(src_format == GL_BGRA)) && (dst_format == GL_RGBA) && (dst_type == GL_FLOAT) && ((src_type == GL_UNSIGNED_BYTE))) {
+        const int r = (src_format==GL_BGRA)?2:0;
+        const int b = (src_format==GL_BGRA)?0:2;
+        const GLfloat k = 1.0f/255.0f;
+        for (int i = 0; i < height; i++) {
+			for (int j = 0; j < width; j++) {
+				((GLfloat*)dst_pos)[0] = ((GLubyte*)src_pos)[r]*k;
+				((GLfloat*)dst_pos)[1] = ((GLubyte*)src_pos)[1]*k;
+				((GLfloat*)dst_pos)[2] = ((GLubyte*)src_pos)[b]*k;
+				((GLfloat*)dst_pos)[3] = ((GLubyte*)src_pos)[3]*k;
+				src_pos += src_stride;
+				dst_pos += dst_stride;
+			}
+			dst_pos += dst_width;
+            src_pos += src_widthadj;
+        }
+        return true;
+    }
     // RGB(A) -> RGB565
     if (((src_format == GL_RGB)||(src_format == GL_RGBA)) && (dst_format == GL_RGB) && (dst_type == GL_UNSIGNED_SHORT_5_6_5) && ((src_type == GL_UNSIGNED_BYTE))) {
         for (int i = 0; i < height; i++) {
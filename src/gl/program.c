@@ -5,6 +5,7 @@
 #include "../glx/hardext.h"
 #include "debug.h"
 #include "fpe.h"
+#include "fpe_cache.h"
 #include "gl4es.h"
 #include "glstate.h"
 #include "loader.h"
@@ -137,6 +138,41 @@ GLuint APIENTRY_GL4ES gl4es_glCreateProgram(void) {
 void actually_deleteshader(GLuint shader);
 void actually_detachshader(GLuint shader);
 
+static void free_uniforms(program_t *glprogram)
+{
+    free(glprogram->uniform_array);
+    free(glprogram->uniform_names);
+    free(glprogram->uniform_sorted);
+    glprogram->uniform_array = NULL;
+    glprogram->uniform_names = NULL;
+    glprogram->uniform_sorted = NULL;
+    glprogram->uniform_count = 0;
+}
+
+static int compare_uniform(const void* a, const void* b)
+{
+    return strcmp((*(uniform_t**)a)->name, (*(uniform_t**)b)->name);
+}
+
+uniform_t* findUniform(program_t *glprogram, const char* name, int l)
+{
+    int lo = 0, hi = glprogram->uniform_count-1;
+    while(lo<=hi) {
+        int mid = (lo+hi)/2;
+        uniform_t *m = glprogram->uniform_sorted[mid];
+        int c = strncmp(m->name, name, l);
+        if(!c && m->name[l])
+            c = 1;
+        if(!c)
+            return m;
+        if(c<0)
+            lo = mid+1;
+        else
+            hi = mid-1;
+    }
+    return NULL;
+}
+
 void deleteProgram(program_t *glprogram, khint_t k_program) {
     free(glprogram->attach);
     // clean attribloc
@@ -150,19 +186,23 @@ void deleteProgram(program_t *glprogram, khint_t k_program) {
     }
     // clean uniform list
     if(glprogram->uniform) {
-        uniform_t *m;
-        kh_foreach_value(glprogram->uniform, m,
-            free(m->name); free(m);
-        )
         kh_destroy(uniformlist, glprogram->uniform);
         glprogram->uniform = NULL;
     }
+    free_uniforms(glprogram);
     // clean cache
     if(glprogram->cache.cache)
         free(glprogram->cache.cache);
     // clean fpe cache if it exist
     if(glprogram->fpe_cache)
         fpe_disposeCache((fpe_cache_t*)glprogram->fpe_cache, 1);
+    free(glprogram->sync);
+    free(glprogram->sync_father);
+    // don't keep a dangling current program
+    if(glstate->gleshard->glprogram == glprogram) {
+        glstate->gleshard->glprogram = NULL;
+        glstate->gleshard->program = 0;
+    }
     // delete program
     kh_del(programlist, glstate->glsl->programs, k_program);
     free(glprogram);
@@ -216,7 +256,7 @@ void APIENTRY_GL4ES gl4es_glDetachShader(GLuint program, GLuint shader) {
 void APIENTRY_GL4ES gl4es_glGetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name) {
     DBG(printf("glGetActiveAttrib(%d, %d, %d, %p, %p, %p, %p)\n", program, index, bufSize, length, size, type, name);)
     FLUSH_BEGINEND;
-    CHECK_PROGRAM(void, program)
+    CHECK_PROGRAM_LINKED(void, program)
 
     if(glprogram->attribloc) {
         attribloc_t *attribloc;
@@ -258,7 +298,7 @@ void APIENTRY_GL4ES gl4es_glGetAttachedShaders(GLuint program, GLsizei maxCount,
 GLint APIENTRY_GL4ES gl4es_glGetAttribLocation(GLuint program, const GLchar *name) {
     DBG(printf("glGetAttribLocation(%d, %s)\n", program, name));
     FLUSH_BEGINEND;
-    CHECK_PROGRAM(GLint, program);
+    CHECK_PROGRAM_LINKED(GLint, program);
 
     if(!glprogram->linked) {
         errorShim(GL_INVALID_OPERATION);
@@ -296,7 +336,7 @@ GLint APIENTRY_GL4ES gl4es_glGetAttribLocation(GLuint program, const GLchar *nam
 void APIENTRY_GL4ES gl4es_glGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name) {
     DBG(printf("glGetActiveUniform(%d, %d, %d, %p, %p, %p, %p)\n", program, index, bufSize, length, size, type, name);)
     FLUSH_BEGINEND;
-    CHECK_PROGRAM(GLvoid, program);
+    CHECK_PROGRAM_LINKED(GLvoid, program);
 
     if(!glprogram->linked) {
         errorShim(GL_INVALID_OPERATION);
@@ -309,22 +349,20 @@ void APIENTRY_GL4ES gl4es_glGetActiveUniform(GLuint program, GLuint index, GLsiz
         return;
     }
 
-    // look in uniform cache, that is filled when program is linked
-    if(glprogram->uniform) {
-        uniform_t *m;
-        kh_foreach_value(glprogram->uniform, m,
-            if(m->internal_id == index) {
-                if(type) *type = m->type;
-                if(size) *size = m->size;
-                if(length) *length = strlen(m->name);
-                if(bufSize && name) {
-                    strncpy(name, m->name, bufSize-1);
-                    name[bufSize-1] = '\0';
-                }
-                DBG(printf(" found %s (%zd), type=%s, size=%d\n", m->name, strlen(m->name), PrintEnum(m->type), m->size);)
-                return;
+    // look in uniform cache, that is filled when program is linked (array elements follow their base)
+    for (int i=0; i<glprogram->uniform_count; i++) {
+        uniform_t *m = &glprogram->uniform_array[i];
+        if(m->internal_id == index) {
+            if(type) *type = m->type;
+            if(size) *size = m->size;
+            if(length) *length = strlen(m->name);
+            if(bufSize && name) {
+                strncpy(name, m->name, bufSize-1);
+                name[bufSize-1] = '\0';
             }
-        );
+            DBG(printf(" found %s (%zd), type=%s, size=%d\n", m->name, strlen(m->name), PrintEnum(m->type), m->size);)
+            return;
+        }
     }
     // end
     DBG(printf(" not found\n");)
@@ -373,6 +411,17 @@ void APIENTRY_GL4ES gl4es_glGetProgramiv(GLuint program, GLenum pname, GLint *pa
 
     LOAD_GLES2(glGetProgramiv);
     noerrorShim();
+    if(pname==GL_COMPLETION_STATUS_KHR) {
+        // must not wait for the link
+        if(glprogram->link_pending) {
+            gles_glGetProgramiv(glprogram->id, pname, params);
+            errorGL();
+        } else
+            *params = GL_TRUE;
+        return;
+    }
+    if(glprogram->link_pending)
+        gl4es_finishLinkProgram(glprogram);
     switch(pname) {
         case GL_DELETE_STATUS:
             if(gles_glGetProgramiv) {
@@ -441,7 +490,7 @@ void APIENTRY_GL4ES gl4es_glGetProgramiv(GLuint program, GLenum pname, GLint *pa
 GLint APIENTRY_GL4ES gl4es_glGetUniformLocation(GLuint program, const GLchar *name) {
     DBG(printf("glGetUniformLocation(%d, %s)\n", program, name);)
     FLUSH_BEGINEND;
-    CHECK_PROGRAM(GLint, program)
+    CHECK_PROGRAM_LINKED(GLint, program)
 
     noerrorShim();
     int res = -1;
@@ -461,18 +510,13 @@ GLint APIENTRY_GL4ES gl4es_glGetUniformLocation(GLuint program, const GLchar *na
             index = index*10 + *(p++)-'0';
         }
     }
-    if(glprogram->uniform) {
-        uniform_t *m;
-        kh_foreach_value(glprogram->uniform, m,
-            if(strlen(m->name)==l && strncmp(m->name, name, l)==0) {
-                res = m->id;
-                if(index>m->size) {
-                    res = -1;   // too big !
-                } else
-                    res += index;
-                break;
-            }
-        )
+    uniform_t *m = findUniform(glprogram, name, l);
+    if(m) {
+        res = m->id;
+        if(index>m->size) {
+            res = -1;   // too big !
+        } else
+            res += index;
     }
     DBG(printf(" location: %d\n", res);)
     return res;
@@ -511,17 +555,18 @@ static void clear_program(program_t *glprogram)
         kh_put(attribloclist, attribloc, 1, &ret);
         kh_del(attribloclist, attribloc, 1);
     }
+    glprogram->link_pending = 0;
     // clear all Uniform cache
     glprogram->num_uniform = 0;
-    if(glprogram->uniform) {
-        uniform_t *m;
-        khint_t k;
-        kh_foreach(glprogram->uniform, k, m,
-            free(m->name); free(m);
-            kh_del(uniformlist, glprogram->uniform, k);
-        )
-    }
+    if(glprogram->uniform)
+        kh_clear(uniformlist, glprogram->uniform);
+    free_uniforms(glprogram);
     glprogram->cache.size = 0;  // reset cache buffer
+    // the fpe custom programs are built from the previous link
+    if(glprogram->fpe_cache) {
+        fpe_disposeCache((fpe_cache_t*)glprogram->fpe_cache, 1);
+        glprogram->fpe_cache = NULL;
+    }
 }
 
 static void fill_program(program_t *glprogram)
@@ -550,7 +595,19 @@ static void fill_program(program_t *glprogram)
     GLenum type = 0;
     GLchar *name = (char*)malloc(maxsize);
     int tu_idx = 0;
+    // 1st pass, ask GLES for the active uniforms, to size the uniform block and the name table
+    typedef struct {
+        GLint   id;
+        GLint   size;
+        GLenum  type;
+        int     name;   // offset in names
+    } active_uniform_t;
+    active_uniform_t *active = (active_uniform_t*)malloc(n*sizeof(active_uniform_t));
+    char *names = (char*)malloc(n*maxsize+1);
+    int count = 0;
+    int names_size = 0;
     for (int i=0; i<n; i++) {
+        active[i].id = -1;
         gles_glGetActiveUniform(glprogram->id, i, maxsize, NULL, &size, &type, name);
         DBG(e2=gles_glGetError();)
         DBG(if(e2==GL_NO_ERROR))
@@ -559,44 +616,78 @@ static void fill_program(program_t *glprogram)
             if(name[strlen(name)-1]==']' && strrchr(name, '[')) (*strrchr(name, '['))='\0';
             GLint id = gles_glGetUniformLocation(glprogram->id, name);
             if(id!=-1) {
-                for (int j = 0; j<size; j++) {
-                    k = kh_put(uniformlist, uniforms, id, &ret);
-                    gluniform = kh_value(uniforms, k) = malloc(sizeof(uniform_t));
-                    memset(gluniform, 0, sizeof(uniform_t));
-                    if(j) {
-                        gluniform->name = malloc(strlen(name)+1+5);
-                        sprintf(gluniform->name, "%s[%d]", name, j);
-                    } else
-                        gluniform->name = strdup(name);
-                    gluniform->id = id;
-                    gluniform->internal_id = i;
-                    gluniform->size = size-j;
-                    gluniform->type = type;
-                    gluniform->cache_offs = uniform_cache+j*uniformsize(type);
-                    gluniform->cache_size = uniformsize(type)*(size-j);
-                    gluniform->builtin = builtin_CheckUniform(glprogram, name, id, size-j);
-                    // TextureUnit grabbing...
-                    if(type==GL_SAMPLER_CUBE) {
-                        glprogram->texunits[tu_idx].id = id;
-                        glprogram->texunits[tu_idx].type=TU_CUBE;
-                        glprogram->texunits[tu_idx].req_tu = glprogram->texunits[tu_idx].act_tu = 0;
-                        ++tu_idx;
-                    } else if (type==GL_SAMPLER_2D) {
-                        glprogram->texunits[tu_idx].id = id;
-                        glprogram->texunits[tu_idx].type=TU_TEX2D;
-                        glprogram->texunits[tu_idx].req_tu = glprogram->texunits[tu_idx].act_tu = 0;
-                        ++tu_idx;
-                    }
-                    DBG(printf(" uniform #%d : \"%s\"%s type=%s size=%d\n", id, gluniform->name, gluniform->builtin?" (builtin) ":"", PrintEnum(gluniform->type), gluniform->size);)
-                    if(gluniform->size==1) ++glprogram->num_uniform;
-                    id++;
+                active[i].id = id;
+                active[i].size = size;
+                active[i].type = type;
+                active[i].name = i*maxsize;
+                strcpy(names+i*maxsize, name);
+                int l = strlen(name);
+                names_size += l+1;
+                for (int j=1; j<size; j++) {
+                    char buff[16];
+                    names_size += l+sprintf(buff, "[%d]", j)+1;
                 }
-                uniform_cache += uniformsize(type)*size;
+                count += size;
             }
         }
         DBG(else printf("LIBGL: Warning, getting Uniform #%d info failed with %s\n", i, PrintEnum(e2));)
     }
     free(name);
+    // 2nd pass, fill the uniform block, one entry per array element
+    glprogram->uniform_array = (uniform_t*)calloc(count, sizeof(uniform_t));
+    glprogram->uniform_names = (char*)malloc(names_size);
+    glprogram->uniform_sorted = (uniform_t**)malloc(count*sizeof(uniform_t*));
+    glprogram->uniform_count = count;
+    gluniform = glprogram->uniform_array;
+    char *p = glprogram->uniform_names;
+    for (int i=0; i<n; i++) {
+        GLint id = active[i].id;
+        if(id==-1)
+            continue;
+        size = active[i].size;
+        type = active[i].type;
+        name = names+active[i].name;
+        for (int j = 0; j<size; j++) {
+            k = kh_put(uniformlist, uniforms, id, &ret);
+            kh_value(uniforms, k) = gluniform;
+            glprogram->uniform_sorted[gluniform-glprogram->uniform_array] = gluniform;
+            gluniform->name = p;
+            if(j)
+                p += sprintf(p, "%s[%d]", name, j)+1;
+            else {
+                strcpy(p, name);
+                p += strlen(name)+1;
+            }
+            gluniform->id = id;
+            gluniform->internal_id = i;
+            gluniform->size = size-j;
+            gluniform->type = type;
+            gluniform->cache_offs = uniform_cache+j*uniformsize(type);
+            gluniform->cache_size = uniformsize(type)*(size-j);
+            gluniform->builtin = builtin_CheckUniform(glprogram, name, id, size-j);
+            // TextureUnit grabbing...
+            if(type==GL_SAMPLER_CUBE) {
+                glprogram->texunits[tu_idx].id = id;
+                glprogram->texunits[tu_idx].type=TU_CUBE;
+                glprogram->texunits[tu_idx].req_tu = glprogram->texunits[tu_idx].act_tu = 0;
+                ++tu_idx;
+            } else if (type==GL_SAMPLER_2D) {
+                glprogram->texunits[tu_idx].id = id;
+                glprogram->texunits[tu_idx].type=TU_TEX2D;
+                glprogram->texunits[tu_idx].req_tu = glprogram->texunits[tu_idx].act_tu = 0;
+                ++tu_idx;
+            }
+            DBG(printf(" uniform #%d : \"%s\"%s type=%s size=%d\n", id, gluniform->name, gluniform->builtin?" (builtin) ":"", PrintEnum(gluniform->type), gluniform->size);)
+            if(gluniform->size==1) ++glprogram->num_uniform;
+            id++;
+            gluniform++;
+        }
+        uniform_cache += uniformsize(type)*size;
+    }
+    free(active);
+    free(names);
+    // the name index, for glGetUniformLocation
+    qsort(glprogram->uniform_sorted, count, sizeof(uniform_t*), compare_uniform);
     // reset uniform cache
     if(glprogram->cache.cap < uniform_cache) {
         glprogram->cache.cap=uniform_cache;
@@ -684,7 +775,7 @@ int gl4es_getProgramBinary(GLuint program, int *length, GLenum *format, void** b
     if(hardext.prgbin_n==0)
         return 0;
     DBG(printf("getProgramBinary(%d, %p, %p, %p)\n", program, length, format, binary);)
-    CHECK_PROGRAM(int, program)
+    CHECK_PROGRAM_LINKED(int, program)
     noerrorShim();
 
     LOAD_GLES_OES(glGetProgramBinary);
@@ -708,7 +799,7 @@ void APIENTRY_GL4ES gl4es_glGetProgramBinary(GLuint program, GLsizei bufSize, GL
         return;
     }
     DBG(printf("glGetProgramBinary(%d, %d, %p, %p, %p)\n", program, bufSize, length, binaryFormat, binary);)
-    CHECK_PROGRAM(void, program)
+    CHECK_PROGRAM_LINKED(void, program)
     LOAD_GLES_OES(glGetProgramBinary);
     gles_glGetProgramBinary(glprogram->id, bufSize, length, binaryFormat, binary);
     errorGL();
@@ -727,12 +818,37 @@ void APIENTRY_GL4ES gl4es_glProgramBinary(GLuint program, GLenum binaryFormat, c
         errorShim(GL_INVALID_OPERATION);
 }
 
+static uint64_t hash_str(uint64_t h, const char* s)
+{
+    // FNV-1a
+    if(!h) h = 14695981039346656037ULL;
+    while(s && *s)
+        h = (h ^ (unsigned char)*(s++)) * 1099511628211ULL;
+    return h;
+}
+
+// user bindings are part of the linked program, in any order
+static uint64_t hash_bindings(program_t *glprogram)
+{
+    uint64_t h = 0;
+    attribloc_t *m;
+    kh_foreach_value(glprogram->attribloc, m,
+        h += hash_str(0, m->name) * (m->index+1);
+    )
+    return h;
+}
+
 void APIENTRY_GL4ES gl4es_glLinkProgram(GLuint program) {
+    gl4es_linkProgram(program, 1);
+}
+
+void gl4es_linkProgram(GLuint program, int usecache) {
     DBG(printf("glLinkProgram(%d)\n", program);)
     FLUSH_BEGINEND;
     CHECK_PROGRAM(void, program)
     noerrorShim();
 
+    uint64_t key = hash_bindings(glprogram);
     clear_program(glprogram);
 
     // check if attached shaders are compatible in term of varying...
@@ -781,18 +897,45 @@ void APIENTRY_GL4ES gl4es_glLinkProgram(GLuint program) {
             if(attribute)
                 gl4es_glBindAttribLocation(glprogram->id, i, attribute);
         }
+    // the same converted shaders and bindings may already be in the PSA
+    if(usecache) {
+        for (int i=0; i<glprogram->attach_size; i++) {
+            shader_t *glshader = getShader(glprogram->attach[i]);
+            if(glshader)
+                key = hash_str(key, glshader->converted);
+        }
+        if(fpe_GetProgramBinaryPSA(glprogram->id, key)) {
+            DBG(printf(" program loaded from PSA\n");)
+            noerrorShim();
+            return;
+        }
+        LOAD_GLES(glGetError);
+        gles_glGetError();  // a refused binary is not an error of the link
+    }
     // ok, continue with linking
     LOAD_GLES2(glLinkProgram);
     if(gles_glLinkProgram) {
         LOAD_GLES(glGetError);
-        LOAD_GLES2(glGetProgramiv);
         gles_glLinkProgram(glprogram->id);
         GLenum err = gles_glGetError();
+        // with parallel compile, the driver links in the background: don't wait for it
+        // until the result is needed (the current program is needed right away)
+        if(hardext.parallelcompile && err==GL_NO_ERROR && glstate->glsl->glprogram!=glprogram) {
+            DBG(printf(" link deferred\n");)
+            glprogram->link_pending = 1;
+            glprogram->link_usecache = usecache;
+            glprogram->link_key = key;
+            noerrorShim();
+            return;
+        }
         // Get Link Status
+        LOAD_GLES2(glGetProgramiv);
         gles_glGetProgramiv(glprogram->id, GL_LINK_STATUS, &glprogram->linked);
         DBG(printf(" link status = %d\n", glprogram->linked);)
         if(glprogram->linked) {
             fill_program(glprogram);
+            if(usecache)
+                fpe_AddProgramBinaryPSA(glprogram->id, key);
             noerrorShimNoPurge();
         } else {
             // should DBG the linker error?
@@ -808,6 +951,36 @@ void APIENTRY_GL4ES gl4es_glLinkProgram(GLuint program) {
     glprogram->linked = 1;
 }
 
+void gl4es_finishLinkProgram(program_t *glprogram) {
+    DBG(printf("finishLinkProgram(%d)\n", glprogram->id);)
+    glprogram->link_pending = 0;
+    LOAD_GLES2(glGetProgramiv);
+    // this one waits for the driver
+    gles_glGetProgramiv(glprogram->id, GL_LINK_STATUS, &glprogram->linked);
+    DBG(printf(" link status = %d\n", glprogram->linked);)
+    if(glprogram->linked) {
+        fill_program(glprogram);
+        if(glprogram->link_usecache)
+            fpe_AddProgramBinaryPSA(glprogram->id, glprogram->link_key);
+        glprogram->linked = 1;
+    } else {
+        DBG(printf(" Link failled!\n");)
+        glprogram->linked = 0;
+    }
+}
+
+void APIENTRY_GL4ES gl4es_glMaxShaderCompilerThreads(GLuint count) {
+    DBG(printf("glMaxShaderCompilerThreads(%u)\n", count);)
+    noerrorShim();
+    if(!hardext.parallelcompile)
+        return;
+    LOAD_GLES_KHR(glMaxShaderCompilerThreads);
+    if(gles_glMaxShaderCompilerThreads) {
+        gles_glMaxShaderCompilerThreads(count);
+        errorGL();
+    }
+}
+
 void APIENTRY_GL4ES gl4es_glUseProgram(GLuint program) {
     DBG(printf("glUseProgram(%d) old=%d\n", program, glstate->glsl->program);)
     PUSH_IF_COMPILING(glUseProgram);
@@ -816,7 +989,7 @@ void APIENTRY_GL4ES gl4es_glUseProgram(GLuint program) {
         glstate->glsl->glprogram=NULL;
         return;
     }
-    CHECK_PROGRAM(void, program)
+    CHECK_PROGRAM_LINKED(void, program)
     noerrorShim();
     DBG(printf("program id=%d\n", glprogram->id);)
 
@@ -825,7 +998,7 @@ void APIENTRY_GL4ES gl4es_glUseProgram(GLuint program) {
 }
 
 void APIENTRY_GL4ES gl4es_glValidateProgram(GLuint program) {
-    CHECK_PROGRAM(void, program)
+    CHECK_PROGRAM_LINKED(void, program)
     FLUSH_BEGINEND;
     noerrorShim();
 
@@ -864,6 +1037,7 @@ AliasExport(void,glGetProgramInfoLog,,(GLuint program, GLsizei maxLength, GLsize
 
 AliasExport(void,glGetProgramBinary,,(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary));
 AliasExport(void,glProgramBinary,,(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length));
+AliasExport(void,glMaxShaderCompilerThreads,ARB,(GLuint count));
 
 
 // ================ GL_ARB_vertex_shader =================
@@ -113,6 +113,7 @@ typedef struct {
     int             cache_size; // this is GLsizeof(type)*size
     uintptr_t       parent_offs;    // in case the uniform is from a fpe custom program
     int             parent_size;    // 0 means not found in parent... like for builtin
+    unsigned int    gen;            // uniform_gen of the program when the value last changed
 } uniform_t;
 
 KHASH_MAP_DECLARE_INT(uniformlist, uniform_t *);
@@ -222,6 +223,11 @@ typedef struct {
     khash_t(uniformlist) *uniform;
     int             num_uniform;
     uniformcache_t  cache;
+    // storage of the uniforms: one block, names in one string table, plus an index sorted by name
+    uniform_t       *uniform_array;
+    char            *uniform_names;
+    uniform_t       **uniform_sorted;
+    int             uniform_count;
     // builtin attrib
     int                             has_builtin_attrib;
     GLint                           builtin_attrib[ATT_MAX];
@@ -276,6 +282,17 @@ typedef struct {
     GLint                           samplersCube[MAX_TEX];
     // that will be an fpe_cache_t*
     void*                           fpe_cache;
+    // uniform changes counter, so fpe custom programs only sync what changed
+    unsigned int                    uniform_gen;
+    // fpe custom program: uniforms to sync from the father program
+    int                             sync_size;
+    uniform_t                       **sync;         // uniforms of this program found in the father...
+    uniform_t                       **sync_father;  // ...and the matching uniforms of the father
+    unsigned int                    sync_gen;       // uniform_gen of the father at the last sync
+    // KHR_parallel_shader_compile: link issued, status and introspection not fetched yet
+    int                             link_pending;
+    int                             link_usecache;
+    uint64_t                        link_key;
 } program_t;
 
 KHASH_MAP_DECLARE_INT(programlist, program_t *);
@@ -301,6 +318,9 @@ void APIENTRY_GL4ES gl4es_glValidateProgram(GLuint program);
 
 int gl4es_useProgramBinary(GLuint program, int length, GLenum format, const void* binary);    // internal
 int gl4es_getProgramBinary(GLuint program, int *length, GLenum *format, void** binary);    // internal
+void gl4es_linkProgram(GLuint program, int usecache);    // internal, usecache to look/store the program in the PSA
+void gl4es_finishLinkProgram(program_t *glprogram);    // internal, wait for a deferred link and fill the program
+void APIENTRY_GL4ES gl4es_glMaxShaderCompilerThreads(GLuint count);
 
 #define CHECK_PROGRAM(type, program) \
     if(!program) { \
@@ -320,6 +340,12 @@ int gl4es_getProgramBinary(GLuint program, int *length, GLenum *format, void** b
         return (type)0; \
     }
 
+// same as CHECK_PROGRAM, but also finish a deferred link, for everything that needs the link result
+#define CHECK_PROGRAM_LINKED(type, program) \
+    CHECK_PROGRAM(type, program) \
+    if(glprogram->link_pending) \
+        gl4es_finishLinkProgram(glprogram);
+
 #define APPLY_PROGRAM(prg, glprg) \
     if(glstate->gleshard->program != prg) {  \
         glstate->gleshard->program = prg;    \
@@ -336,6 +362,7 @@ void GoUniformMatrix3fv(program_t *glprogram, GLint location, GLsizei count, GLb
 void GoUniformMatrix4fv(program_t *glprogram, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
 int GetUniformi(program_t *glprogram, GLint location);
 const char* GetUniformName(program_t *glprogram, GLint location);
+uniform_t* findUniform(program_t *glprogram, const char* name, int l);  // binary search on the l first chars of name
 
 GLvoid APIENTRY_GL4ES glBindAttribLocationARB(GLhandleARB programObj, GLuint index, const GLcharARB *name);
 GLvoid APIENTRY_GL4ES glGetActiveAttribARB(GLhandleARB programObj, GLuint index, GLsizei maxLength, GLsizei *length, GLint *size, GLenum *type, GLcharARB *name);
@@ -342,6 +342,13 @@ void APIENTRY_GL4ES gl4es_glGetShaderiv(GLuint shader, GLenum pname, GLint *para
             else
                 *params = 0;
             break;
+        case GL_COMPLETION_STATUS_KHR:
+            if(hardext.parallelcompile) {
+                gles_glGetShaderiv(glshader->id, pname, params);
+                errorGL();
+            } else
+                *params = GL_TRUE;
+            break;
         default:
             errorShim(GL_INVALID_ENUM);
     }
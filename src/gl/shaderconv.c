@@ -1,6 +1,7 @@
 #include "shaderconv.h"
 
 #include <stdio.h>
+#include "khash.h"
 #include "../glx/hardext.h"
 #include "debug.h"
 #include "fpe_shader.h"
@@ -437,7 +438,7 @@ static const char* gl4es_VertexAttrib = "_gl4es_VertexAttrib_";
 char gl_VA[MAX_VATTRIB][32] = {0};
 char gl4es_VA[MAX_VATTRIB][32] = {0};
 
-char* ConvertShader(const char* pEntry, int isVertex, shaderconv_need_t *need)
+static char* ConvertShader_internal(const char* pEntry, int isVertex, shaderconv_need_t *need)
 {
   #define ShadAppend(S) Tmp = gl4es_append(Tmp, &tmpsize, S)
 
@@ -728,12 +729,19 @@ char* ConvertShader(const char* pEntry, int isVertex, shaderconv_need_t *need)
         // don't increment headline count, as all variying and attributes should be created before
       }
       // check for builtin OpenGL attributes...
+      // replace all gl_name by _gl4es_ ones in one go
       int n = sizeof(builtin_attrib)/sizeof(builtin_attrib_t);
+      const char* S[n];
+      const char* D[n];
+      int found[n];
+      for (int i=0; i<n; i++) {
+          S[i] = builtin_attrib[i].glname;
+          D[i] = builtin_attrib[i].name;
+      }
+      Tmp = gl4es_inplace_replace_list(Tmp, &tmpsize, n, S, D, found);
       for (int i=0; i<n; i++) {
-          if(strstr(Tmp, builtin_attrib[i].glname)) {
+          if(found[i]) {
               // ok, this attribute is used
-              // replace gl_name by _gl4es_ one
-              Tmp = gl4es_inplace_replace(Tmp, &tmpsize, builtin_attrib[i].glname, builtin_attrib[i].name);
               // insert a declaration of it
               char def[100];
               sprintf(def, "attribute %s %s %s;\n", builtin_attrib[i].prec, builtin_attrib[i].type, builtin_attrib[i].name);
@@ -742,11 +750,18 @@ char* ConvertShader(const char* pEntry, int isVertex, shaderconv_need_t *need)
       }
       if(strstr(Tmp, gl_VertexAttrib)) {
         // Generic VA from Old Programs
+        const char* S[MAX_VATTRIB];
+        const char* D[MAX_VATTRIB];
+        int found[MAX_VATTRIB];
+        for (int i=0; i<MAX_VATTRIB; ++i) {
+          S[i] = gl_VA[i];
+          D[i] = gl4es_VA[i];
+        }
+        Tmp = gl4es_inplace_replace_list(Tmp, &tmpsize, MAX_VATTRIB, S, D, found);
         for (int i=0; i<MAX_VATTRIB; ++i) {
           char A[100];
-          if(gl4es_find_string(Tmp, gl_VA[i])) {
+          if(found[i]) {
             sprintf(A, "attribute highp vec4 %s%d;\n", gl4es_VertexAttrib, i);
-            Tmp = gl4es_inplace_replace(Tmp, &tmpsize, gl_VA[i], gl4es_VA[i]);
             Tmp = gl4es_inplace_insert(gl4es_getline(Tmp, headline++), A, Tmp, &tmpsize);
           }
         }
@@ -860,7 +875,7 @@ char* ConvertShader(const char* pEntry, int isVertex, shaderconv_need_t *need)
   {
     if(strstr(Tmp, "transpose(") || strstr(Tmp, "transpose ") || strstr(Tmp, "transpose\t")) {
       Tmp = gl4es_inplace_insert(gl4es_getline(Tmp, headline), gl4es_transpose, Tmp, &tmpsize);
-      gl4es_inplace_replace(Tmp, &tmpsize, "transpose", "gl4es_transpose");
+      Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "transpose", "gl4es_transpose");
       // don't increment headline count, as all variying and attributes should be created before
     }
     // check for builtin matrix uniform...
@@ -908,12 +923,19 @@ char* ConvertShader(const char* pEntry, int isVertex, shaderconv_need_t *need)
         }
       }
 
+      // replace all gl_name by _gl4es_ ones in one go
       int n = sizeof(builtin_matrix)/sizeof(builtin_matrix_t);
+      const char* S[n];
+      const char* D[n];
+      int found[n];
+      for (int i=0; i<n; i++) {
+          S[i] = builtin_matrix[i].glname;
+          D[i] = builtin_matrix[i].name;
+      }
+      Tmp = gl4es_inplace_replace_list(Tmp, &tmpsize, n, S, D, found);
       for (int i=0; i<n; i++) {
-          if(strstr(Tmp, builtin_matrix[i].glname)) {
+          if(found[i]) {
               // ok, this matrix is used
-              // replace gl_name by _gl4es_ one
-              Tmp = gl4es_inplace_replace(Tmp, &tmpsize, builtin_matrix[i].glname, builtin_matrix[i].name);
               // insert a declaration of it
               char def[100];
               int ishighp = (isVertex || hardext.highp)?1:0;
@@ -1010,23 +1032,14 @@ char* ConvertShader(const char* pEntry, int isVertex, shaderconv_need_t *need)
     headline+=gl4es_countline(gl4es_MaterialParametersSource);
     Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_MaterialParameters", "_gl4es_MaterialParameters");
   }
-  if(strstr(Tmp, "gl_LightSource")) {
-    Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_LightSource", "_gl4es_LightSource");
-  }
-  if(strstr(Tmp, "gl_LightModel"))
-    Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_LightModel", "_gl4es_LightModel");
-  if(strstr(Tmp, "gl_FrontLightModelProduct"))
-    Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_FrontLightModelProduct", "_gl4es_FrontLightModelProduct");
-  if(strstr(Tmp, "gl_BackLightModelProduct"))
-    Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_BackLightModelProduct", "_gl4es_BackLightModelProduct");
-  if(strstr(Tmp, "gl_FrontLightProduct"))
-    Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_FrontLightProduct", "_gl4es_FrontLightProduct");
-  if(strstr(Tmp, "gl_BackLightProduct"))
-    Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_BackLightProduct", "_gl4es_BackLightProduct");
-  if(strstr(Tmp, "gl_FrontMaterial"))
-    Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_FrontMaterial", "_gl4es_FrontMaterial");
-  if(strstr(Tmp, "gl_BackMaterial"))
-    Tmp = gl4es_inplace_replace(Tmp, &tmpsize, "gl_BackMaterial", "_gl4es_BackMaterial");
+  {
+    static const char* S[] = {"gl_LightSource", "gl_LightModel", "gl_FrontLightModelProduct", "gl_BackLightModelProduct",
+                              "gl_FrontLightProduct", "gl_BackLightProduct", "gl_FrontMaterial", "gl_BackMaterial"};
+    static const char* D[] = {"_gl4es_LightSource", "_gl4es_LightModel", "_gl4es_FrontLightModelProduct", "_gl4es_BackLightModelProduct",
+                              "_gl4es_FrontLightProduct", "_gl4es_BackLightProduct", "_gl4es_FrontMaterial", "_gl4es_BackMaterial"};
+    if(strstr(Tmp, "gl_Light") || strstr(Tmp, "gl_Front") || strstr(Tmp, "gl_Back"))
+      Tmp = gl4es_inplace_replace_list(Tmp, &tmpsize, sizeof(S)/sizeof(S[0]), S, D, NULL);
+  }
   if(strstr(Tmp, "gl_MaxLights"))
   {
     Tmp = gl4es_inplace_insert(gl4es_getline(Tmp, 2), gl4es_MaxLightsSource, Tmp, &tmpsize);
@@ -1271,6 +1284,98 @@ char* ConvertShader(const char* pEntry, int isVertex, shaderconv_need_t *need)
   return Tmp;
 }
 
+// Conversion results, so the same source converted again with the same need
+// (shared shaders, redoShader, custom FPE variants) doesn't run all the passes
+typedef struct convcache_s {
+  char*             source;
+  int               isVertex;
+  int               hasneed;
+  shaderconv_need_t need_in;
+  shaderconv_need_t need_out;
+  char*             converted;
+} convcache_t;
+
+KHASH_MAP_INIT_INT64(convcache, convcache_t*);
+static kh_convcache_t *convcache = NULL;
+#define MAX_CONVCACHE_SHADERS 512
+
+static uint64_t hash_conv(const char* s, int isVertex, const shaderconv_need_t *need)
+{
+  // FNV-1a, on the source, the need and the few options that change the conversion
+  uint64_t h = 14695981039346656037ULL;
+  while(*s)
+    h = (h ^ (unsigned char)*(s++)) * 1099511628211ULL;
+  int flags[5] = {isVertex, globals4es.notexarray, globals4es.comments, globals4es.shadernogles, globals4es.nointovlhack};
+  for (int i=0; i<sizeof(flags); ++i)
+    h = (h ^ ((const unsigned char*)flags)[i]) * 1099511628211ULL;
+  if(need)
+    for (int i=0; i<sizeof(shaderconv_need_t); ++i)
+      h = (h ^ ((const unsigned char*)need)[i]) * 1099511628211ULL;
+  return h;
+}
+
+static void free_convcache()
+{
+  convcache_t *c;
+  kh_foreach_value(convcache, c,
+    free(c->source);
+    free(c->converted);
+    free(c);
+  );
+  kh_clear(convcache, convcache);
+}
+
+void FreeShaderConvCache()
+{
+  if(!convcache)
+    return;
+  free_convcache();
+  kh_destroy(convcache, convcache);
+  convcache = NULL;
+}
+
+char* ConvertShader(const char* pEntry, int isVertex, shaderconv_need_t *need)
+{
+  // debug output wants the conversion to actually run
+  if(globals4es.dbgshaderconv)
+    return ConvertShader_internal(pEntry, isVertex, need);
+  if(!convcache)
+    convcache = kh_init(convcache);
+  uint64_t key = hash_conv(pEntry, isVertex, need);
+  khint_t k = kh_get(convcache, convcache, key);
+  if(k!=kh_end(convcache)) {
+    convcache_t *c = kh_value(convcache, k);
+    if(c->isVertex==isVertex && c->hasneed==(need?1:0) && (!need || !memcmp(&c->need_in, need, sizeof(shaderconv_need_t)))
+      && !strcmp(c->source, pEntry)) {
+      if(need)
+        memcpy(need, &c->need_out, sizeof(shaderconv_need_t));
+      return strdup(c->converted);
+    }
+  }
+  convcache_t *c = (convcache_t*)calloc(1, sizeof(convcache_t));
+  c->isVertex = isVertex;
+  c->hasneed = need?1:0;
+  if(need)
+    memcpy(&c->need_in, need, sizeof(shaderconv_need_t));
+  char* ret = ConvertShader_internal(pEntry, isVertex, need);
+  if(need)
+    memcpy(&c->need_out, need, sizeof(shaderconv_need_t));
+  c->source = strdup(pEntry);
+  c->converted = strdup(ret);
+  if(kh_size(convcache)>=MAX_CONVCACHE_SHADERS)
+    free_convcache();   // simple, and the working set is usually much smaller
+  int r;
+  k = kh_put(convcache, convcache, key, &r);
+  if(!r) {
+    convcache_t *old = kh_value(convcache, k);
+    free(old->source);
+    free(old->converted);
+    free(old);
+  }
+  kh_value(convcache, k) = c;
+  return ret;
+}
+
 int isBuiltinAttrib(const char* name) {
     int n = sizeof(builtin_attrib)/sizeof(builtin_attrib_t);
     for (int i=0; i<n; i++) {
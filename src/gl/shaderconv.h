@@ -5,6 +5,7 @@
 #include "program.h"
 
 char* ConvertShader(const char* pBuffer, int isVertex, shaderconv_need_t *need);
+void FreeShaderConvCache();
 
 int isBuiltinAttrib(const char* name);
 int isBuiltinMatrix(const char* name);
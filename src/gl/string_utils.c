@@ -8,25 +8,130 @@ const char* AllSeparators = " \t\n\r.,;()[]{}-<>+*/%&\\\"'^$=!:?";
 
 char* gl4es_resize_if_needed(char* pBuffer, int *size, int addsize);
 
-char* gl4es_inplace_replace(char* pBuffer, int* size, const char* S, const char* D)
+// occurrences positions, to move the text only once per replace
+#define MAX_STACK_POS 64
+static int collect_pos(const char* pBuffer, const char* S, int lS, const char* D, int lD, int simple, int** pos, int* stack)
 {
-    int lS = strlen(S), lD = strlen(D);
-    pBuffer = gl4es_resize_if_needed(pBuffer, size, (lD-lS)*gl4es_count_string(pBuffer, S));
-    char* p = pBuffer;
+    int n = 0, cap = MAX_STACK_POS;
+    *pos = stack;
+    const char* p = pBuffer;
+    char prev_end = '\0';  // what is before the end of last replacement, once replaced
     while((p = strstr(p, S)))
     {
         // found an occurrence of S
+        // the char before is the one from the replaced text if it's just after the previous one
+        char before = (p==pBuffer)?'\0':p[-1];
+        if(n && (*pos)[n-1]+lS==p-pBuffer)
+            before = prev_end;
         // check if good to replace, strchr also found '\0' :)
-        if(strchr(AllSeparators, p[lS])!=NULL && (p==pBuffer || strchr(AllSeparators, p[-1])!=NULL)) {
-            // move out rest of string
-            memmove(p+lD, p+lS, strlen(p)-lS+1);
-            // replace
-            memcpy(p, D, strlen(D));
-            // next
-            p+=lD;
-        } else p+=lS;
+        if(simple || (strchr(AllSeparators, p[lS])!=NULL && strchr(AllSeparators, before)!=NULL)) {
+            prev_end = lD?D[lD-1]:before;
+            if(n==cap) {
+                cap *= 2;
+                if(*pos==stack) {
+                    *pos = (int*)malloc(cap*sizeof(int));
+                    memcpy(*pos, stack, n*sizeof(int));
+                } else
+                    *pos = (int*)realloc(*pos, cap*sizeof(int));
+            }
+            (*pos)[n++] = p - pBuffer;
+        }
+        p+=lS;
     }
-    
+    return n;
+}
+
+static char* replace_pos(char* pBuffer, int* size, const char* S, const char* D, int simple)
+{
+    int lS = strlen(S), lD = strlen(D);
+    int stack[MAX_STACK_POS];
+    int *pos;
+    int n = collect_pos(pBuffer, S, lS, D, lD, simple, &pos, stack);
+    if(!n)
+        return pBuffer;
+    int len = strlen(pBuffer);
+    pBuffer = gl4es_resize_if_needed(pBuffer, size, (lD-lS)*n);
+    if(lD<=lS) {
+        // shrinking, go forward
+        char* dst = pBuffer + pos[0];
+        for (int i=0; i<n; ++i) {
+            memcpy(dst, D, lD);
+            dst += lD;
+            int from = pos[i]+lS;
+            int to = (i+1<n)?pos[i+1]:len+1;
+            memmove(dst, pBuffer+from, to-from);
+            dst += to-from;
+        }
+    } else {
+        // growing, go backward
+        int end = len+1;
+        for (int i=n-1; i>=0; --i) {
+            int from = pos[i]+lS;
+            int shift = (lD-lS)*(i+1);
+            memmove(pBuffer+from+shift, pBuffer+from, end-from);
+            memcpy(pBuffer+pos[i]+(lD-lS)*i, D, lD);
+            end = pos[i];
+        }
+    }
+    if(pos!=stack)
+        free(pos);
+    return pBuffer;
+}
+
+char* gl4es_inplace_replace(char* pBuffer, int* size, const char* S, const char* D)
+{
+    return replace_pos(pBuffer, size, S, D, 0);
+}
+
+char* gl4es_inplace_replace_list(char* pBuffer, int* size, int n, const char** S, const char** D, int* found)
+{
+    // one pass on the identifiers of the buffer, each one looked up in S
+    unsigned char first[256] = {0};
+    int lS[n];
+    for (int i=0; i<n; ++i) {
+        lS[i] = strlen(S[i]);
+        first[(unsigned char)S[i][0]] = 1;
+        if(found) found[i] = 0;
+    }
+    int len = strlen(pBuffer);
+    char* out = NULL;
+    int outsize = 0, outlen = 0, copied = 0;
+    const char* p = pBuffer;
+    while(*p) {
+        if(strchr(AllSeparators, *p)) {
+            ++p;
+            continue;
+        }
+        const char* tok = p;
+        while(*p && !strchr(AllSeparators, *p)) ++p;
+        if(!first[(unsigned char)*tok])
+            continue;
+        int l = p - tok;
+        for (int i=0; i<n; ++i)
+            if(lS[i]==l && !memcmp(tok, S[i], l)) {
+                int lD = strlen(D[i]);
+                int chunk = (tok - pBuffer) - copied;
+                if(outlen+chunk+lD+1>outsize) {
+                    outsize = (outlen+chunk+lD+1+(len-copied))*2;
+                    out = (char*)realloc(out, outsize);
+                }
+                memcpy(out+outlen, pBuffer+copied, chunk);
+                outlen += chunk;
+                memcpy(out+outlen, D[i], lD);
+                outlen += lD;
+                copied = p - pBuffer;
+                if(found) found[i]++;
+                break;
+            }
+    }
+    if(!out)
+        return pBuffer;
+    // the rest and back in the buffer
+    int chunk = len - copied;
+    pBuffer = gl4es_resize_if_needed(pBuffer, size, outlen+chunk-len);
+    memmove(pBuffer+outlen, pBuffer+copied, chunk+1);
+    memcpy(pBuffer, out, outlen);
+    free(out);
     return pBuffer;
 }
 
@@ -230,19 +335,5 @@ int gl4es_countstring_simple(char* pBuffer, const char* S)
 
 char* gl4es_inplace_replace_simple(char* pBuffer, int* size, const char* S, const char* D)
 {
-    int lS = strlen(S), lD = strlen(D);
-    pBuffer = gl4es_resize_if_needed(pBuffer, size, (lD-lS)*gl4es_countstring_simple(pBuffer, S));
-    char* p = pBuffer;
-    while((p = strstr(p, S)))
-    {
-        // found an occurrence of S
-        // move out rest of string
-        memmove(p+lD, p+lS, strlen(p)-lS+1);
-        // replace
-        memcpy(p, D, strlen(D));
-        // next
-        p+=lD;
-    }
-    
-    return pBuffer;
+    return replace_pos(pBuffer, size, S, D, 1);
 }
@@ -8,6 +8,8 @@ char* gl4es_find_string_nc(char* pBuffer, const char* S);
 int gl4es_count_string(const char* pBuffer, const char* S);
 char* gl4es_resize_if_needed(char* pBuffer, int *size, int addsize);
 char* gl4es_inplace_replace(char* pBuffer, int* size, const char* S, const char* D);
+// replace all identifiers S[i] (without separators) by D[i] in a single pass, no chaining. found[i] gets the count for S[i] (can be NULL)
+char* gl4es_inplace_replace_list(char* pBuffer, int* size, int n, const char** S, const char** D, int* found);
 char* gl4es_append(char* pBuffer, int* size, const char* S);
 char* gl4es_inplace_insert(char* pBuffer, const char* S, char* master, int* size);
 char* gl4es_getline(char* pBuffer, int num);
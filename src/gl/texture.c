@@ -903,6 +903,44 @@ GLenum minmag_float(GLenum filt) {
     }
 }
 
+// can the pixels of the bound unpack buffer be given as-is to GLES, using a real PBO?
+static int unpack_pbo_direct(gltexture_t *bound, GLenum target, GLint level, GLsizei width, GLenum format, GLenum type) {
+    glbuffer_t *unpack = glstate->vao->unpack;
+    if(!unpack || !unpack->data || !hardext.gles3 || globals4es.nopbo)
+        return 0;
+    if ((glstate->texture.unpack_row_length && glstate->texture.unpack_row_length != width) || glstate->texture.unpack_skip_pixels || glstate->texture.unpack_skip_rows)
+        return 0;
+    // no conversion, no CPU side processing
+    if(format!=bound->format || type!=bound->type || bound->inter_format!=bound->format || bound->inter_type!=bound->type)
+        return 0;
+    if(bound->shrink || bound->useratio || globals4es.texdump || bound->streamed)
+        return 0;
+    if((target==GL_TEXTURE_2D) && globals4es.texcopydata)
+        return 0;
+    // lower levels computed on the CPU
+    if(bound->base_level == level && !(bound->max_level==level && level==0))
+        return 0;
+    return 1;
+}
+
+// same, for a glTexImage2D split in an allocation followed by a glTexSubImage2D:
+// check the texture as the allocation (with NULL data) will leave it
+static int unpack_pbo_split(gltexture_t *bound, GLenum target, GLint level, GLsizei width, GLenum internalformat, GLenum format, GLenum type) {
+    if(globals4es.texshrink || globals4es.texstream)
+        return 0;
+    gltexture_t tmp = *bound;
+    GLenum f = format, t = type;
+    GLenum new_format = swizzle_internalformat(&internalformat, format, type);
+    swizzle_texture(width, 1, &f, &t, internalformat, new_format, NULL, &tmp);
+#ifdef __BIG_ENDIAN__
+    if(type==GL_UNSIGNED_INT_8_8_8_8)
+#else
+    if(type==GL_UNSIGNED_INT_8_8_8_8_REV)
+#endif
+        type = GL_UNSIGNED_BYTE;
+    return unpack_pbo_direct(&tmp, target, level, width, format, type);
+}
+
 void APIENTRY_GL4ES gl4es_glTexImage2D(GLenum target, GLint level, GLint internalformat,
                   GLsizei width, GLsizei height, GLint border,
                   GLenum format, GLenum type, const GLvoid *data) {
@@ -946,6 +984,17 @@ void APIENTRY_GL4ES gl4es_glTexImage2D(GLenum target, GLint level, GLint interna
         PUSH_IF_COMPILING(glTexImage2D);
     }
 
+    if(target==GL_TEXTURE_2D && width>0 && height>0 && !border
+        && unpack_pbo_split(glstate->texture.bound[glstate->texture.active][what_target(target)], target, level, width, internalformat, format, type)) {
+        // allocate the texture, then upload the pixels with a real unpack PBO
+        glbuffer_t *unpack = glstate->vao->unpack;
+        glstate->vao->unpack = NULL;
+        gl4es_glTexImage2D(target, level, internalformat, width, height, border, format, type, NULL);
+        glstate->vao->unpack = unpack;
+        gl4es_glTexSubImage2D(target, level, 0, 0, width, height, format, type, data);
+        return;
+    }
+
 #ifdef __BIG_ENDIAN__
     if(type==GL_UNSIGNED_INT_8_8_8_8)
 #else
@@ -1582,6 +1631,31 @@ void APIENTRY_GL4ES gl4es_glTexSubImage2D(GLenum target, GLint level, GLint xoff
     if(level && bound->mipmap_auto)
         return;
 
+    if (unpack_pbo_direct(bound, target, level, width, format, type)) {
+        // same genmipmap logic as below, but done by GLES
+        int genmipmap = 0;
+        if(((bound->max_level == level) && (level || bound->mipmap_need)))
+            genmipmap = 1;
+        if((target!=GL_TEXTURE_RECTANGLE_ARB) && (bound->mipmap_need || bound->mipmap_auto) && ((level==0) || (level==bound->max_level)))
+            genmipmap = 1;
+        if(((bound->max_level==bound->base_level) && (bound->base_level==0)) || (globals4es.automipmap==3))
+            genmipmap = 0;
+        if(!genmipmap || rtarget==GL_TEXTURE_2D) {
+            DBG(printf(" => using real unpack PBO\n");)
+            bind_unpack_pbo(glstate->vao->unpack);
+            errorGL();
+            gles_glTexSubImage2D(rtarget, level, xoffset, yoffset,
+                         width, height, format, type, data);
+            bind_unpack_pbo(NULL);
+            DBG(CheckGLError(1);)
+            if(genmipmap) {
+                LOAD_GLES2_OR_OES(glGenerateMipmap);
+                gles_glGenerateMipmap(rtarget);
+            }
+            return;
+        }
+    }
+
     if ((glstate->texture.unpack_row_length && glstate->texture.unpack_row_length != width) || glstate->texture.unpack_skip_pixels || glstate->texture.unpack_skip_rows) {
         int imgWidth, pixelSize, dstWidth;
         pixelSize = pixel_sizeof(format, type);
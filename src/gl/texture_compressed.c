@@ -434,8 +434,10 @@ void APIENTRY_GL4ES gl4es_glGetCompressedTexImage(GLenum target, GLint lod, GLvo
     glstate->vao->unpack = NULL;
     glstate->vao->pack = NULL;
     GLvoid *datab = (GLvoid*)img;
-    if (pack)
+    if (pack) {
+        realize_pack_buffer(pack);
         datab = (char*)datab + (uintptr_t)pack->data;
+    }
 
     // alloc the memory for source image and grab the file
     GLuint *src = (GLuint*)malloc(width*height*4);
@@ -23,6 +23,9 @@
 #define DBG(a)
 #endif
 
+// size of the temporary buffer used for glReadPixels conversion, a frame is read by band of rows
+#define READPIXELS_BAND (256*1024)
+
 static int inline nlevel(int size, int level) {
     if(size) {
         size>>=level;
@@ -181,9 +184,15 @@ void APIENTRY_GL4ES gl4es_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei
     }
     LOAD_GLES(glReadPixels);
     errorGL();
+    glbuffer_t *pack = glstate->vao->pack;
+    // with a real PBO, the read is async and the conversion is done when the buffer is accessed
+    int async = (pack && pack->data && hardext.gles3 && !globals4es.nopbo);
     GLvoid* dst = data;
-    if (glstate->vao->pack)
-        dst = (char*)dst + (uintptr_t)glstate->vao->pack->data;
+    if (pack) {
+        if(!async)
+            realize_pack_buffer(pack);
+        dst = (char*)dst + (uintptr_t)pack->data;
+    }
         
     readfboBegin();
     if ((format == GL_RGBA && type == GL_UNSIGNED_BYTE)     // should not use default GL_RGBA on Pandora as it's very slow...
@@ -191,7 +200,10 @@ void APIENTRY_GL4ES gl4es_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei
        || (format == GL_DEPTH_COMPONENT && (type == GL_FLOAT || type==GL_HALF_FLOAT)))   // this one will probably fail, as DEPTH is not readable on most GLES hardware 
     {
         // easy passthru
-        gles_glReadPixels(x, y, width, height, format, type, dst);
+        if(async)
+            readpixels_to_pbo(pack, x, y, width, height, format, type, format, type, (uintptr_t)data);
+        else
+            gles_glReadPixels(x, y, width, height, format, type, dst);
         readfboEnd();
         return;
     }
@@ -199,14 +211,30 @@ void APIENTRY_GL4ES gl4es_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei
     int use_bgra = 0;
     if(glstate->readf==GL_BGRA && glstate->readt==GL_UNSIGNED_BYTE)
         use_bgra = 1;   // if IMPLEMENTATION_READ is BGRA, then use it as it's probably faster then RGBA.
-    GLvoid *pixels = malloc(width*height*4);
-    gles_glReadPixels(x, y, width, height, use_bgra?GL_BGRA:GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-    if (! pixel_convert(pixels, &dst, width, height,
-                        use_bgra?GL_BGRA:GL_RGBA, GL_UNSIGNED_BYTE, format, type, 0,glstate->texture.pack_align)) {
-        LOGE("ReadPixels error: (%s, UNSIGNED_BYTE -> %s, %s )\n",
-            PrintEnum(use_bgra?GL_BGRA:GL_RGBA), PrintEnum(format), PrintEnum(type));
+    if(async) {
+        readpixels_to_pbo(pack, x, y, width, height, use_bgra?GL_BGRA:GL_RGBA, GL_UNSIGNED_BYTE, format, type, (uintptr_t)data);
+        readfboEnd();
+        return;
+    }
+    // read and convert by bands of rows, in the scratch buffer, so no big temporary buffer is allocated each time
+    const GLenum readf = use_bgra?GL_BGRA:GL_RGBA;
+    const int src_row = widthalign(width*4, glstate->texture.pack_align);
+    const int dst_row = widthalign(width*pixel_sizeof(format, type), glstate->texture.pack_align);
+    int band = READPIXELS_BAND / src_row;
+    if (band<1) band = 1;
+    if (band>height) band = height;
+    gl4es_scratch(band*src_row);
+    for (int yy=0; yy<height; yy+=band) {
+        int h = (height-yy<band)?(height-yy):band;
+        GLvoid *out = (char*)dst + yy*dst_row;
+        gles_glReadPixels(x, y+yy, width, h, readf, GL_UNSIGNED_BYTE, glstate->scratch);
+        if (! pixel_convert(glstate->scratch, &out, width, h,
+                            readf, GL_UNSIGNED_BYTE, format, type, 0, glstate->texture.pack_align)) {
+            LOGE("ReadPixels error: (%s, UNSIGNED_BYTE -> %s, %s )\n",
+                PrintEnum(readf), PrintEnum(format), PrintEnum(type));
+            break;
+        }
     }
-    free(pixels);
     readfboEnd();
     return;
 }
@@ -249,8 +277,10 @@ void APIENTRY_GL4ES gl4es_glGetTexImage(GLenum target, GLint level, GLenum forma
     DBG(printf("glGetTexImage(%s, %i, %s, %s, 0x%p), texture=0x%x, size=%i,%i\n", PrintEnum(target), level, PrintEnum(format), PrintEnum(type), img, bound->glname, width, height);)
     
     GLvoid *dst = img;
-    if (glstate->vao->pack)
+    if (glstate->vao->pack) {
+        realize_pack_buffer(glstate->vao->pack);
         dst = (char*)dst + (uintptr_t)glstate->vao->pack->data;
+    }
 #ifdef TEXSTREAM
     if (globals4es.texstream && bound->streamed) {
         noerrorShim();
@@ -13,6 +13,18 @@
 #define DBG(a)
 #endif
 
+// track the change of a uniform (and the following array elements)
+static void uniform_changed(program_t *glprogram, uniform_t *m, int count)
+{
+    unsigned int gen = ++glprogram->uniform_gen;
+    m->gen = gen;
+    for (int i=1; i<count; i++) {
+        khint_t k = kh_get(uniformlist, glprogram->uniform, m->id+i);
+        if(k!=kh_end(glprogram->uniform))
+            kh_value(glprogram->uniform, k)->gen = gen;
+    }
+}
+
 int uniformsize(GLenum type) {
     #define GO(T, t, s) \
         case T: return sizeof(t)*s
@@ -108,7 +120,7 @@ int n_uniform(GLenum type) {
 void APIENTRY_GL4ES gl4es_glGetUniformfv(GLuint program, GLint location, GLfloat *params) {
     DBG(printf("glGetUniformfv(%d, %d, %p)\n", program, location, params);)
     FLUSH_BEGINEND;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
 
     khint_t k;
     uniform_t *gluniform = NULL;
@@ -135,7 +147,7 @@ void APIENTRY_GL4ES gl4es_glGetUniformfv(GLuint program, GLint location, GLfloat
 void APIENTRY_GL4ES gl4es_glGetUniformiv(GLuint program, GLint location, GLint *params) {
     DBG(printf("glGetUniformiv(%d, %d, %p)\n", program, location, params);)
     FLUSH_BEGINEND;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
 
     khint_t k;
     uniform_t *gluniform = NULL;
@@ -192,6 +204,7 @@ void GoUniformfv(program_t *glprogram, GLint location, int size, int count, cons
     }
     // update uniform
     memcpy((char*)glprogram->cache.cache + m->cache_offs, value, rsize);
+    uniform_changed(glprogram, m, count);
     LOAD_GLES2(glUniform1fv);
     LOAD_GLES2(glUniform2fv);
     LOAD_GLES2(glUniform3fv);
@@ -240,6 +253,7 @@ void GoUniformiv(program_t *glprogram, GLint location, int size, int count, cons
     DBG(printf("Uniform updated, cache=%p(%d/%d), offset=%p, size=%d\n", glprogram->cache.cache, glprogram->cache.size, glprogram->cache.cap, (void*)m->cache_offs, rsize);)
     // update uniform
     memcpy((char*)glprogram->cache.cache + m->cache_offs, value, rsize);
+    uniform_changed(glprogram, m, count);
     LOAD_GLES2(glUniform1iv);
     LOAD_GLES2(glUniform2iv);
     LOAD_GLES2(glUniform3iv);
@@ -260,7 +274,7 @@ void APIENTRY_GL4ES gl4es_glUniform1f(GLint location, GLfloat v0) {
     DBG(printf("glUniform1f(%d, %f)\n", location, v0);)
     PUSH_IF_COMPILING(glUniform1f);
     GLuint program = glstate->glsl->program; 
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 1, 1, &v0);
 }
@@ -269,7 +283,7 @@ void APIENTRY_GL4ES gl4es_glUniform2f(GLint location, GLfloat v0, GLfloat v1) {
     PUSH_IF_COMPILING(glUniform2f);
     GLfloat fl[2] = {v0, v1};
     GLuint program = glstate->glsl->program; 
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 2, 1, fl);
 }
@@ -278,7 +292,7 @@ void APIENTRY_GL4ES gl4es_glUniform3f(GLint location, GLfloat v0, GLfloat v1, GL
     PUSH_IF_COMPILING(glUniform3f);
     GLfloat fl[3] = {v0, v1, v2};
     GLuint program = glstate->glsl->program; 
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 3, 1, fl);
 }
@@ -287,7 +301,7 @@ void APIENTRY_GL4ES gl4es_glUniform4f(GLint location, GLfloat v0, GLfloat v1, GL
     PUSH_IF_COMPILING(glUniform4f);
     GLfloat fl[4] = {v0, v1, v2, v3};
     GLuint program = glstate->glsl->program; 
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 4, 1, fl);
 }
@@ -295,7 +309,7 @@ void APIENTRY_GL4ES gl4es_glUniform1i(GLint location, GLint v0) {
     DBG(printf("glUniform1i(%d, %d)\n", location, v0);)
     PUSH_IF_COMPILING(glUniform1i);
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 1, 1, &v0);
 }
@@ -304,7 +318,7 @@ void APIENTRY_GL4ES gl4es_glUniform2i(GLint location, GLint v0, GLint v1) {
     PUSH_IF_COMPILING(glUniform2i);
     GLint fl[2] = {v0, v1};
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 2, 1, fl);
 }
@@ -313,7 +327,7 @@ void APIENTRY_GL4ES gl4es_glUniform3i(GLint location, GLint v0, GLint v1, GLint
     PUSH_IF_COMPILING(glUniform3i);
     GLint fl[3] = {v0, v1, v2};
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 3, 1, fl);
 }
@@ -322,7 +336,7 @@ void APIENTRY_GL4ES gl4es_glUniform4i(GLint location, GLint v0, GLint v1, GLint
     PUSH_IF_COMPILING(glUniform4i);
     GLint fl[4] = {v0, v1, v2, v3};
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 4, 1, fl);
 }
@@ -331,7 +345,7 @@ void APIENTRY_GL4ES gl4es_glUniform1fv(GLint location, GLsizei count, const GLfl
     DBG(printf("glUniform1fv(%d, %d, %p) =>(%f)\n", location, count, value, value[0]);)
     PUSH_IF_COMPILING(glUniform1fv);
     GLuint program = glstate->glsl->program; 
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 1, count, value);
 }
@@ -339,7 +353,7 @@ void APIENTRY_GL4ES gl4es_glUniform2fv(GLint location, GLsizei count, const GLfl
     DBG(printf("glUniform2fv(%d, %d, %p) =>(%f %f)\n", location, count, value, value[0], value[1]);)
     PUSH_IF_COMPILING(glUniform2fv);
     GLuint program = glstate->glsl->program; 
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 2, count, value);
 }
@@ -347,7 +361,7 @@ void APIENTRY_GL4ES gl4es_glUniform3fv(GLint location, GLsizei count, const GLfl
     DBG(printf("glUniform3fv(%d, %d, %p) =>(%f %f, %f)\n", location, count, value, value[0], value[1], value[2]);)
     PUSH_IF_COMPILING(glUniform3fv);
     GLuint program = glstate->glsl->program; 
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 3, count, value);
 }
@@ -355,35 +369,35 @@ void APIENTRY_GL4ES gl4es_glUniform4fv(GLint location, GLsizei count, const GLfl
     DBG(printf("glUniform4fv(%d, %d, %p) =>(%f %f, %f, %f)\n", location, count, value, value[0], value[1], value[2], value[3]);)
     PUSH_IF_COMPILING(glUniform4fv);
     GLuint program = glstate->glsl->program; 
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 4, count, value);
 }
 void APIENTRY_GL4ES gl4es_glUniform1iv(GLint location, GLsizei count, const GLint *value) {
     PUSH_IF_COMPILING(glUniform1iv);
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 1, count, value);
 }
 void APIENTRY_GL4ES gl4es_glUniform2iv(GLint location, GLsizei count, const GLint *value) {
     PUSH_IF_COMPILING(glUniform2iv);
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 2, count, value);
 }
 void APIENTRY_GL4ES gl4es_glUniform3iv(GLint location, GLsizei count, const GLint *value) {
     PUSH_IF_COMPILING(glUniform3iv);
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 3, count, value);
 }
 void APIENTRY_GL4ES gl4es_glUniform4iv(GLint location, GLsizei count, const GLint *value) {
     PUSH_IF_COMPILING(glUniform4iv);
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 4, count, value);
 }
@@ -392,7 +406,7 @@ void APIENTRY_GL4ES gl4es_glUniformMatrix2fv(GLint location, GLsizei count, GLbo
     DBG(printf("glUniformMatrix2fv(%d, %d, %d, %p)\n", location, count, transpose, value);)
     PUSH_IF_COMPILING(glUniformMatrix2fv);
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformMatrix2fv(glprogram, location, count, transpose, value);
 }
@@ -400,7 +414,7 @@ void APIENTRY_GL4ES gl4es_glUniformMatrix2fv(GLint location, GLsizei count, GLbo
 void APIENTRY_GL4ES gl4es_glProgramUniform1f(GLuint program, GLint location, GLfloat v0) {
     DBG(printf("glUniform1f(%d, %f)\n", location, v0);)
     PUSH_IF_COMPILING(glUniform1f);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 1, 1, &v0);
 }
@@ -408,7 +422,7 @@ void APIENTRY_GL4ES gl4es_glProgramUniform2f(GLuint program, GLint location, GLf
     DBG(printf("glUniform2f(%d, %f, %f)\n", location, v0, v1);)
     PUSH_IF_COMPILING(glUniform2f);
     GLfloat fl[2] = {v0, v1};
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 2, 1, fl);
 }
@@ -416,7 +430,7 @@ void APIENTRY_GL4ES gl4es_glProgramUniform3f(GLuint program, GLint location, GLf
     DBG(printf("glUniform3f(%d, %f, %f, %f)\n", location, v0, v1, v2);)
     PUSH_IF_COMPILING(glUniform3f);
     GLfloat fl[3] = {v0, v1, v2};
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 3, 1, fl);
 }
@@ -424,14 +438,14 @@ void APIENTRY_GL4ES gl4es_glProgramUniform4f(GLuint program, GLint location, GLf
     DBG(printf("glUniform4f(%d, %f, %f, %f, %f)\n", location, v0, v1, v2, v3);)
     PUSH_IF_COMPILING(glUniform4f);
     GLfloat fl[4] = {v0, v1, v2, v3};
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 4, 1, fl);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniform1i(GLuint program, GLint location, GLint v0) {
     DBG(printf("glUniform1i(%d, %d)\n", location, v0);)
     PUSH_IF_COMPILING(glUniform1i);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 1, 1, &v0);
 }
@@ -439,7 +453,7 @@ void APIENTRY_GL4ES gl4es_glProgramUniform2i(GLuint program, GLint location, GLi
     DBG(printf("glUniform2i(%d, %d, %d)\n", location, v0, v1);)
     PUSH_IF_COMPILING(glUniform2i);
     GLint fl[2] = {v0, v1};
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 2, 1, fl);
 }
@@ -447,7 +461,7 @@ void APIENTRY_GL4ES gl4es_glProgramUniform3i(GLuint program, GLint location, GLi
     DBG(printf("glUniform3i(%d, %d, %d, %d)\n", location, v0, v1, v2);)
     PUSH_IF_COMPILING(glUniform3i);
     GLint fl[3] = {v0, v1, v2};
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 3, 1, fl);
 }
@@ -455,7 +469,7 @@ void APIENTRY_GL4ES gl4es_glProgramUniform4i(GLuint program, GLint location, GLi
     DBG(printf("glUniform4i(%d, %d, %d, %d, %d)\n", location, v0, v1, v2, v3);)
     PUSH_IF_COMPILING(glUniform4i);
     GLint fl[4] = {v0, v1, v2, v3};
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 4, 1, fl);
 }
@@ -463,52 +477,52 @@ void APIENTRY_GL4ES gl4es_glProgramUniform4i(GLuint program, GLint location, GLi
 void APIENTRY_GL4ES gl4es_glProgramUniform1fv(GLuint program, GLint location, GLsizei count, const GLfloat *value) {
     DBG(printf("glUniform1fv(%d, %d, %p) =>(%f)\n", location, count, value, value[0]);)
     PUSH_IF_COMPILING(glUniform1fv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 1, count, value);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniform2fv(GLuint program, GLint location, GLsizei count, const GLfloat *value) {
     DBG(printf("glUniform2fv(%d, %d, %p) =>(%f %f)\n", location, count, value, value[0], value[1]);)
     PUSH_IF_COMPILING(glUniform2fv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 2, count, value);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniform3fv(GLuint program, GLint location, GLsizei count, const GLfloat *value) {
     DBG(printf("glUniform3fv(%d, %d, %p) =>(%f %f, %f)\n", location, count, value, value[0], value[1], value[2]);)
     PUSH_IF_COMPILING(glUniform3fv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 3, count, value);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniform4fv(GLuint program, GLint location, GLsizei count, const GLfloat *value) {
     DBG(printf("glUniform4fv(%d, %d, %p) =>(%f %f, %f, %f)\n", location, count, value, value[0], value[1], value[2], value[3]);)
     PUSH_IF_COMPILING(glUniform4fv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformfv(glprogram, location, 4, count, value);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniform1iv(GLuint program, GLint location, GLsizei count, const GLint *value) {
     PUSH_IF_COMPILING(glUniform1iv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 1, count, value);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniform2iv(GLuint program, GLint location, GLsizei count, const GLint *value) {
     PUSH_IF_COMPILING(glUniform2iv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 2, count, value);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniform3iv(GLuint program, GLint location, GLsizei count, const GLint *value) {
     PUSH_IF_COMPILING(glUniform3iv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 3, count, value);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniform4iv(GLuint program, GLint location, GLsizei count, const GLint *value) {
     PUSH_IF_COMPILING(glUniform4iv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformiv(glprogram, location, 4, count, value);
 }
@@ -516,7 +530,7 @@ void APIENTRY_GL4ES gl4es_glProgramUniform4iv(GLuint program, GLint location, GL
 void APIENTRY_GL4ES gl4es_glProgramUniformMatrix2fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     DBG(printf("glUniformMatrix2fv(%d, %d, %d, %p)\n", location, count, transpose, value);)
     PUSH_IF_COMPILING(glUniformMatrix2fv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformMatrix2fv(glprogram, location, count, transpose, value);
 }
@@ -562,6 +576,7 @@ void GoUniformMatrix2fv(program_t *glprogram, GLint location, GLsizei count, GLb
     }
     // update uniform
     memcpy((char*)glprogram->cache.cache + m->cache_offs, v, rsize);
+    uniform_changed(glprogram, m, count);
     LOAD_GLES2(glUniformMatrix2fv);
     if (gles_glUniformMatrix2fv) {
         gles_glUniformMatrix2fv(m->id, count, GL_FALSE, v);
@@ -574,7 +589,7 @@ void APIENTRY_GL4ES gl4es_glUniformMatrix3fv(GLint location, GLsizei count, GLbo
     DBG(printf("glUniformMatrix3fv(%d, %d, %d, %p)\n", location, count, transpose, value);)
     PUSH_IF_COMPILING(glUniformMatrix3fv);
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformMatrix3fv(glprogram, location, count, transpose, value);
 }
@@ -582,7 +597,7 @@ void APIENTRY_GL4ES gl4es_glUniformMatrix3fv(GLint location, GLsizei count, GLbo
 void APIENTRY_GL4ES gl4es_glProgramUniformMatrix3fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     DBG(printf("glUniformMatrix3fv(%d, %d, %d, %p)\n", location, count, transpose, value);)
     PUSH_IF_COMPILING(glUniformMatrix3fv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformMatrix3fv(glprogram, location, count, transpose, value);
 }
@@ -628,6 +643,7 @@ void GoUniformMatrix3fv(program_t *glprogram, GLint location, GLsizei count, GLb
     }
     // update uniform
     memcpy((char*)glprogram->cache.cache + m->cache_offs, v, rsize);
+    uniform_changed(glprogram, m, count);
     LOAD_GLES2(glUniformMatrix3fv);
     if (gles_glUniformMatrix3fv) {
         gles_glUniformMatrix3fv(m->id, count, GL_FALSE, v);
@@ -639,14 +655,14 @@ void APIENTRY_GL4ES gl4es_glUniformMatrix4fv(GLint location, GLsizei count, GLbo
     DBG(printf("glUniformMatrix4fv(%d, %d, %d, %p) p=>(%f, %f, %f, %f, %f...)\n", location, count, transpose, value, value[0], value[1], value[2], value[3], value[4]);)
     PUSH_IF_COMPILING(glUniformMatrix4fv);
     GLuint program = glstate->glsl->program;
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformMatrix4fv(glprogram, location, count, transpose, value);
 }
 void APIENTRY_GL4ES gl4es_glProgramUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
     DBG(printf("glUniformMatrix4fv(%d, %d, %d, %p) p=>(%f, %f, %f, %f, %f...)\n", location, count, transpose, value, value[0], value[1], value[2], value[3], value[4]);)
     PUSH_IF_COMPILING(glUniformMatrix4fv);
-    CHECK_PROGRAM(void, program);
+    CHECK_PROGRAM_LINKED(void, program);
     APPLY_PROGRAM(program, glprogram);
     GoUniformMatrix4fv(glprogram, location, count, transpose, value);
 }
@@ -690,6 +706,7 @@ void GoUniformMatrix4fv(program_t *glprogram, GLint location, GLsizei count, GLb
     }
     // update uniform
     memcpy((char*)glprogram->cache.cache + m->cache_offs, v, rsize);
+    uniform_changed(glprogram, m, count);
     LOAD_GLES2(glUniformMatrix4fv);
     if (gles_glUniformMatrix4fv) {
         gles_glUniformMatrix4fv(m->id, count, GL_FALSE, v);
@@ -306,6 +306,14 @@ void GetHardwareExtensions(int notest)
         hardext.mirrored = 1;
     }
     S("GL_OES_mapbuffer ", mapbuffer, 0);
+    S("GL_EXT_map_buffer_range ", mapbufferrange, 0);
+    if(hardext.esversion>1) {
+        const char *Version = (const char *) gles_glGetString(GL_VERSION);
+        if(Version && strstr(Version, "OpenGL ES 3")) {
+            hardext.gles3 = 1;
+            SHUT_LOGD("GLES 3.0+ context detected\n");
+        }
+    }
     S("GL_OES_element_index_uint ", elementuint, 1);
     S("GL_OES_packed_depth_stencil ", depthstencil, 1);
     S("GL_OES_depth24 ", depth24, 1);
@@ -373,6 +381,7 @@ void GetHardwareExtensions(int notest)
         SHUT_LOGD("Max vertex attrib: %d\n", hardext.maxvattrib);
         S("GL_OES_standard_derivatives ", derivatives, 1);
         S("GL_ARM_shader_framebuffer_fetch", shader_fbfetch, 1);
+        S("GL_KHR_parallel_shader_compile ", parallelcompile, 1);
         S("GL_OES_get_program ", prgbinary, 1);
         if(!hardext.prgbinary) {
             S("GL_OES_get_program_binary ", prgbinary, 1);
@@ -46,9 +46,11 @@ typedef struct _hardext {
     int aniso;          // Max ANISOTROPIC filter available (0 if not)
     int srgb;           // EGL_KHR_gl_colorspace
     int mapbuffer;      // GL_OES_mapbuffer
+    int mapbufferrange; // GL_EXT_map_buffer_range
     int drawbuffers;    // GL_EXT_draw_buffers
     // es2 stuffs
     int esversion;      // 1 is ES1.1 backend, 2 is ES2
+    int gles3;          // the ES2 backend is in fact a GLES 3.0+ context
     int maxvattrib;     // GL_MAX_VERTEX_ATTRIBS (or 0 if not using es2)
     int maxteximage;    // GL_MAX_TEXTURE_IMAGE_UNITS for es2
     int maxvarying;     // GL_MAX_VARYING_VECTORS for es2
@@ -69,6 +71,7 @@ typedef struct _hardext {
     int prgbinary;      // GL_OES_get_program extension
     int prgbin_n;       // number of program binary format support
     int shader_fbfetch; // GL_ARM_shader_framebuffer_fetch
+    int parallelcompile; // GL_KHR_parallel_shader_compile
     int glsl120;        // does version 120 glsl shader are supported ?
     int glsl300es;      // does version 300es glsl shader are supported ?
     int glsl310es;      // does version 300es glsl shader are supported ?
@@ -0,0 +1,327 @@
+/*
+ * shaderbench: run the shader converters of gl4es on a corpus of shaders
+ * No GPU or EGL needed, everything runs on the CPU.
+ *
+ * Files are picked by extension:
+ *   .vert .vs .vsh      GLSL vertex shader
+ *   .frag .fs .fsh      GLSL fragment shader
+ *   .vp / .fp           ARB vertex / fragment program (or any file starting with !!ARBvp1.0 / !!ARBfp1.0)
+ *
+ * For each shader, the conversion time (best of the iterations), the number of
+ * allocations done by one conversion and the converted size are reported.
+ * With a golden directory, each output is compared to <golden>/<file>.out
+ * (-u to write them instead). The exit code is non 0 if anything failed.
+ */
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../gl/arbconverter.h"
+#include "../gl/init.h"
+#include "../gl/preproc.h"
+#include "../gl/shaderconv.h"
+#include "../glx/hardext.h"
+
+#ifdef SHADERBENCH_WRAP
+// count allocations, with -Wl,--wrap
+static int nallocs = 0;
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+char* __real_strdup(const char* s);
+void* __wrap_malloc(size_t size) { ++nallocs; return __real_malloc(size); }
+void* __wrap_calloc(size_t nmemb, size_t size) { ++nallocs; return __real_calloc(nmemb, size); }
+void* __wrap_realloc(void* ptr, size_t size) { ++nallocs; return __real_realloc(ptr, size); }
+char* __wrap_strdup(const char* s) { ++nallocs; return __real_strdup(s); }
+#define ALLOCS  nallocs
+#else
+#define ALLOCS  0
+#endif
+
+typedef enum {
+    SHADER_NONE = 0,
+    SHADER_VERTEX,
+    SHADER_FRAGMENT,
+    SHADER_ARB_VERTEX,
+    SHADER_ARB_FRAGMENT
+} shadertype_t;
+
+static const char* type_name[] = {"", "vert", "frag", "arbvp", "arbfp"};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000.0 + ts.tv_nsec/1000.0;
+}
+
+static char* read_file(const char* name)
+{
+    FILE* f = fopen(name, "rb");
+    if(!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long l = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* buff = (char*)malloc(l+1);
+    if(fread(buff, 1, l, f)!=l) {
+        free(buff);
+        fclose(f);
+        return NULL;
+    }
+    buff[l] = '\0';
+    fclose(f);
+    return buff;
+}
+
+static int write_file(const char* name, const char* content)
+{
+    FILE* f = fopen(name, "wb");
+    if(!f)
+        return 0;
+    int l = strlen(content);
+    int ret = fwrite(content, 1, l, f)==l;
+    fclose(f);
+    return ret;
+}
+
+static shadertype_t get_type(const char* name, const char* source)
+{
+    if(!strncmp(source, "!!ARBvp1.0", 10)) return SHADER_ARB_VERTEX;
+    if(!strncmp(source, "!!ARBfp1.0", 10)) return SHADER_ARB_FRAGMENT;
+    const char* ext = strrchr(name, '.');
+    if(!ext)
+        return SHADER_NONE;
+    ++ext;
+    if(!strcmp(ext, "vert") || !strcmp(ext, "vs") || !strcmp(ext, "vsh")) return SHADER_VERTEX;
+    if(!strcmp(ext, "frag") || !strcmp(ext, "fs") || !strcmp(ext, "fsh")) return SHADER_FRAGMENT;
+    if(!strcmp(ext, "vp")) return SHADER_ARB_VERTEX;
+    if(!strcmp(ext, "fp")) return SHADER_ARB_FRAGMENT;
+    return SHADER_NONE;
+}
+
+// each iteration gets a slightly different source (an extra comment), so the
+// conversion caches can't hide the work
+static char* iteration_source(const char* source, shadertype_t type, int iter)
+{
+    int l = strlen(source);
+    char* ret = (char*)malloc(l+64);
+    if(type==SHADER_ARB_VERTEX || type==SHADER_ARB_FRAGMENT) {
+        // after the header line
+        const char* p = strchr(source, '\n');
+        int h = p?(p-source+1):l;
+        memcpy(ret, source, h);
+        sprintf(ret+h, "# shaderbench %d\n%s", iter, source+h);
+    } else
+        sprintf(ret, "%s\n// shaderbench %d\n", source, iter);
+    return ret;
+}
+
+static char* convert(const char* source, shadertype_t type, char** error)
+{
+    *error = NULL;
+    switch(type) {
+        case SHADER_VERTEX:
+        case SHADER_FRAGMENT:
+            {
+                shaderconv_need_t need = {0};
+                need.need_texcoord = -1;
+                return ConvertShader(source, type==SHADER_VERTEX?1:0, &need);
+            }
+        case SHADER_ARB_VERTEX:
+        case SHADER_ARB_FRAGMENT:
+            {
+                int error_ptr = -1;
+                char* error_msg = NULL;
+                char* ret = gl4es_convertARB(source, type==SHADER_ARB_VERTEX?1:0, &error_msg, &error_ptr);
+                if(error_ptr!=-1) {
+                    free(ret);
+                    ret = NULL;
+                    *error = error_msg?error_msg:strdup("unknown error");
+                } else
+                    free(error_msg);
+                return ret;
+            }
+        default:
+            return NULL;
+    }
+}
+
+// line number of the first difference, 0 if same
+static int first_diff(const char* a, const char* b)
+{
+    int line = 1;
+    while(*a && *a==*b) {
+        if(*a=='\n') ++line;
+        ++a; ++b;
+    }
+    return (*a==*b)?0:line;
+}
+
+static void setup_hardware()
+{
+    // a plain GLES2 device
+    hardext.esversion = 2;
+    hardext.maxtex = 8;
+    hardext.maxteximage = 8;
+    hardext.maxvarying = 8;
+    hardext.maxvattrib = 16;
+    hardext.maxlights = 8;
+    hardext.maxplanes = 6;
+    hardext.maxdrawbuffers = 1;
+    hardext.maxcolorattach = 1;
+    hardext.highp = 1;
+    hardext.npot = 1;
+    hardext.derivatives = 1;
+    hardext.fragdepth = 0;
+    hardext.shaderlod = 0;
+    globals4es.nobanner = 1;
+}
+
+static void usage(const char* prog)
+{
+    printf("Usage: %s [-n iterations] [-g golden_folder] [-u] [-q] corpus_folder\n", prog);
+    printf("  -n N    run each conversion N times, best time is reported (default 10)\n");
+    printf("  -g DIR  compare the outputs with DIR/<file>.out\n");
+    printf("  -u      write the outputs in the golden folder instead of comparing\n");
+    printf("  -q      only print errors and the summary\n");
+}
+
+int main(int argc, const char** argv)
+{
+    int iterations = 10;
+    const char* golden = NULL;
+    const char* corpus = NULL;
+    int update = 0, quiet = 0;
+    for (int i=1; i<argc; ++i) {
+        if(!strcmp(argv[i], "-n") && i+1<argc)
+            iterations = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-g") && i+1<argc)
+            golden = argv[++i];
+        else if(!strcmp(argv[i], "-u"))
+            update = 1;
+        else if(!strcmp(argv[i], "-q"))
+            quiet = 1;
+        else if(argv[i][0]!='-' && !corpus)
+            corpus = argv[i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if(!corpus || (update && !golden)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if(iterations<1)
+        iterations = 1;
+
+    setup_hardware();
+
+    struct dirent **list;
+    int n = scandir(corpus, &list, NULL, alphasort);
+    if(n<0) {
+        printf("Cannot read folder \"%s\"\n", corpus);
+        return 2;
+    }
+
+    int nshaders = 0, nfailed = 0, nmismatch = 0;
+    double total_time = 0., total_preproc = 0.;
+    long total_allocs = 0, total_in = 0, total_out = 0;
+    if(!quiet)
+        printf("%-40s %-5s %10s %10s %8s %8s %8s %s\n", "shader", "type", "conv(us)", "preproc(us)", "allocs", "in", "out", "golden");
+    for (int f=0; f<n; ++f) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", corpus, list[f]->d_name);
+        char* source = (list[f]->d_name[0]=='.')?NULL:read_file(path);
+        shadertype_t type = source?get_type(list[f]->d_name, source):SHADER_NONE;
+        if(type==SHADER_NONE) {
+            free(source);
+            free(list[f]);
+            continue;
+        }
+        ++nshaders;
+        // reference conversion, on the untouched source
+        char* error = NULL;
+        int allocs = ALLOCS;
+        char* converted = convert(source, type, &error);
+        allocs = ALLOCS - allocs;
+        if(!converted) {
+            printf("%-40s %-5s FAILED: %s\n", list[f]->d_name, type_name[type], error?error:"no output");
+            ++nfailed;
+            free(error);
+            free(source);
+            free(list[f]);
+            continue;
+        }
+        // timings
+        double best = -1., best_preproc = -1.;
+        for (int it=0; it<iterations; ++it) {
+            char* src = iteration_source(source, type, it);
+            double t0 = now();
+            char* tmp = convert(src, type, &error);
+            double t = now() - t0;
+            if(best<0. || t<best) best = t;
+            free(tmp);
+            free(error);
+            if(type==SHADER_VERTEX || type==SHADER_FRAGMENT) {
+                extensions_t exts = {0};
+                char* version = NULL;
+                t0 = now();
+                tmp = preproc(src, 0, 0, &exts, &version);
+                t = now() - t0;
+                if(best_preproc<0. || t<best_preproc) best_preproc = t;
+                if(tmp!=src) free(tmp);
+                free(version);
+                free(exts.ext);
+            }
+            free(src);
+        }
+        if(best_preproc<0.) best_preproc = 0.;
+        // golden
+        const char* status = "";
+        if(golden) {
+            char gpath[4096];
+            snprintf(gpath, sizeof(gpath), "%s/%s.out", golden, list[f]->d_name);
+            if(update) {
+                status = write_file(gpath, converted)?"written":"write error";
+            } else {
+                char* ref = read_file(gpath);
+                static char diff[64];
+                if(!ref) {
+                    status = "missing";
+                    ++nmismatch;
+                } else {
+                    int line = first_diff(ref, converted);
+                    if(line) {
+                        snprintf(diff, sizeof(diff), "differs at line %d", line);
+                        status = diff;
+                        ++nmismatch;
+                    } else
+                        status = "ok";
+                    free(ref);
+                }
+            }
+        }
+        int lin = strlen(source), lout = strlen(converted);
+        if(!quiet || (golden && !update && strcmp(status, "ok")))
+            printf("%-40s %-5s %10.1f %10.1f %8d %8d %8d %s\n", list[f]->d_name, type_name[type], best, best_preproc, allocs, lin, lout, status);
+        total_time += best;
+        total_preproc += best_preproc;
+        total_allocs += allocs;
+        total_in += lin;
+        total_out += lout;
+        free(converted);
+        free(source);
+        free(list[f]);
+    }
+    free(list);
+
+    printf("%d shaders, %d failed", nshaders, nfailed);
+    if(golden && !update)
+        printf(", %d golden mismatch", nmismatch);
+    printf("\nconversion %.1f us, preproc %.1f us, %ld allocs, %ld bytes in, %ld bytes out\n", total_time, total_preproc, total_allocs, total_in, total_out);
+    return (nfailed || nmismatch)?1:0;
+}
@@ -0,0 +1,6 @@
+// linear fog on the primary color
+void main()
+{
+    float f = clamp((gl_Fog.end - gl_FogFragCoord) * gl_Fog.scale, 0.0, 1.0);
+    gl_FragColor = mix(gl_Fog.color, gl_Color, f);
+}
@@ -0,0 +1,11 @@
+#version 120
+// one directional light, using the builtin light state
+varying vec3 normal;
+void main()
+{
+    normal = normalize(gl_NormalMatrix * gl_Normal);
+    float d = max(dot(normal, normalize(gl_LightSource[0].position.xyz)), 0.0);
+    gl_FrontColor = gl_FrontMaterial.ambient * gl_LightSource[0].ambient
+                  + d * gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse;
+    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+}
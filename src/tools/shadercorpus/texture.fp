@@ -0,0 +1,6 @@
+!!ARBfp1.0
+# modulate a texture with the color
+TEMP t;
+TEX t, fragment.texcoord[0], texture[0], 2D;
+MUL result.color, t, fragment.color;
+END
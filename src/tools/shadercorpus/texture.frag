@@ -0,0 +1,8 @@
+// modulate a texture with the interpolated color
+uniform sampler2D tex;
+varying vec4 color;
+void main()
+{
+    vec4 t = texture2D(tex, gl_TexCoord[0].st);
+    gl_FragColor = t * color;
+}
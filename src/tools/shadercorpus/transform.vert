@@ -0,0 +1,8 @@
+// fixed pipeline style transform, with builtin attributes and matrices
+varying vec4 color;
+void main()
+{
+    color = gl_Color;
+    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;
+    gl_Position = ftransform();
+}
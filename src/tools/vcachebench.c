@@ -0,0 +1,200 @@
+/*
+ * vcachebench: run the vertex cache optimisation of compiled Display Lists
+ * (LIBGL_VCACHEOPT) on a few generated meshes. No GPU or EGL needed.
+ *
+ * For each mesh, the ACMR (Average Cache Miss Ratio, measured with a 16-entry
+ * FIFO cache, so the vertices transformed per triangle) before and after the
+ * pass is reported, with the time of the pass (best of the iterations).
+ * The exit code is non 0 if the pass made any mesh worse, or split a quad.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../gl/const.h"
+#include "../gl/init.h"
+#include "../gl/list.h"
+#include "../gl/listopt.h"
+
+typedef struct {
+    const char* name;
+    GLenum      mode_init;  // GL_QUADS: 6 indices per quad, as glEnd leaves them
+    int         len;
+    int         ilen;
+    GLushort*   indices;
+} mesh_t;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000.0 + ts.tv_nsec/1000.0;
+}
+
+// n x n quads, 2 triangles each, in row order
+static void make_grid(mesh_t* m, int n)
+{
+    m->mode_init = GL_TRIANGLES;
+    m->len = (n+1)*(n+1);
+    m->ilen = n*n*6;
+    m->indices = (GLushort*)malloc(m->ilen*sizeof(GLushort));
+    GLushort* p = m->indices;
+    for (int y=0; y<n; ++y)
+        for (int x=0; x<n; ++x) {
+            GLushort a = y*(n+1)+x, b = a+1, c = a+n+1, d = c+1;
+            *p++ = a; *p++ = b; *p++ = c;
+            *p++ = b; *p++ = d; *p++ = c;
+        }
+}
+
+// same primitives (triangles, or quads as 2 triangles), in random order (like a mesh exported without care)
+static void shuffle_primitives(mesh_t* m, unsigned int seed)
+{
+    srand(seed);
+    const int prim = (m->mode_init==GL_QUADS)?6:3;
+    int nprim = m->ilen/prim;
+    for (int i=nprim-1; i>0; --i) {
+        int j = rand()%(i+1);
+        GLushort tmp[6];
+        memcpy(tmp, m->indices+i*prim, prim*sizeof(GLushort));
+        memcpy(m->indices+i*prim, m->indices+j*prim, prim*sizeof(GLushort));
+        memcpy(m->indices+j*prim, tmp, prim*sizeof(GLushort));
+    }
+}
+
+// n x n welded quads (so sharing their vertices), in row order
+static void make_quad_grid(mesh_t* m, int n)
+{
+    make_grid(m, n);
+    m->mode_init = GL_QUADS;
+    // a quad a,b,d,c is the 2 triangles a,b,d and a,d,c
+    for (int i=0; i<m->ilen; i+=6) {
+        GLushort a = m->indices[i+0], b = m->indices[i+1], c = m->indices[i+2], d = m->indices[i+4];
+        m->indices[i+2] = d;
+        m->indices[i+3] = a; m->indices[i+4] = d; m->indices[i+5] = c;
+    }
+}
+
+// UV sphere, stacks x slices, in stack order (long rows, so little reuse)
+static void make_sphere(mesh_t* m, int stacks, int slices)
+{
+    m->len = (stacks+1)*(slices+1);
+    m->ilen = stacks*slices*6;
+    m->mode_init = GL_TRIANGLES;
+    m->indices = (GLushort*)malloc(m->ilen*sizeof(GLushort));
+    GLushort* p = m->indices;
+    for (int y=0; y<stacks; ++y)
+        for (int x=0; x<slices; ++x) {
+            GLushort a = y*(slices+1)+x, b = a+1, c = a+slices+1, d = c+1;
+            *p++ = a; *p++ = b; *p++ = c;
+            *p++ = b; *p++ = d; *p++ = c;
+        }
+}
+
+// a compiled list with only vertices, as glEnd leaves it
+static renderlist_t* make_list(const mesh_t* m)
+{
+    renderlist_t* list = (renderlist_t*)calloc(1, sizeof(renderlist_t));
+    list->mode = GL_TRIANGLES;
+    list->mode_init = m->mode_init;
+    list->len = m->len;
+    list->ilen = m->ilen;
+    list->indices = (GLushort*)malloc(m->ilen*sizeof(GLushort));
+    memcpy(list->indices, m->indices, m->ilen*sizeof(GLushort));
+    list->vert = (GLfloat*)calloc(m->len*4, sizeof(GLfloat));
+    for (int i=0; i<m->len; ++i)
+        list->vert[i*4+0] = (GLfloat)i;
+    return list;
+}
+
+// the 2 triangles of each quad must stay together, for the edges in GL_LINE mode
+static int quads_kept(const renderlist_t* list)
+{
+    for (int i=0; i<list->ilen; i+=6)
+        if(list->indices[i+3]!=list->indices[i] || list->indices[i+4]!=list->indices[i+2])
+            return 0;
+    return 1;
+}
+
+static void free_list(renderlist_t* list)
+{
+    free(list->indices);
+    free(list->vert);
+    free(list->ind_lines);
+    free(list);
+}
+
+static void usage(const char* prog)
+{
+    printf("Usage: %s [-n iterations] [-g grid_size] [-s seed]\n", prog);
+    printf("  -n N    run the pass N times on each mesh, best time is reported (default 10)\n");
+    printf("  -g N    size of the grids, in quads (default 100)\n");
+    printf("  -s N    seed of the shuffled grid (default 1)\n");
+}
+
+int main(int argc, const char** argv)
+{
+    int iterations = 10;
+    int grid = 100;
+    unsigned int seed = 1;
+    for (int i=1; i<argc; ++i) {
+        if(!strcmp(argv[i], "-n") && i+1<argc)
+            iterations = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-g") && i+1<argc)
+            grid = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-s") && i+1<argc)
+            seed = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if(iterations<1)
+        iterations = 1;
+    if(grid<2 || (grid+1)*(grid+1)>65536) {
+        printf("Grid size must be between 2 and 255\n");
+        return 2;
+    }
+
+    globals4es.nobanner = 1;
+    globals4es.vcacheopt = 1;
+
+    mesh_t meshes[4];
+    meshes[0].name = "grid";
+    make_grid(&meshes[0], grid);
+    meshes[1].name = "shuffled grid";
+    make_grid(&meshes[1], grid);
+    shuffle_primitives(&meshes[1], seed);
+    meshes[2].name = "sphere";
+    make_sphere(&meshes[2], 64, 128);
+    meshes[3].name = "shuffled quads";
+    make_quad_grid(&meshes[3], grid);
+    shuffle_primitives(&meshes[3], seed);
+
+    int worse = 0;
+    printf("%-16s %10s %10s %10s %10s %10s\n", "mesh", "triangles", "vertices", "before", "after", "time(us)");
+    for (int i=0; i<4; ++i) {
+        const mesh_t* m = &meshes[i];
+        float before = renderlist_acmr(m->indices, m->ilen, m->len);
+        float after = 0.0f;
+        int broken = 0;
+        double best = -1.;
+        for (int it=0; it<iterations; ++it) {
+            renderlist_t* list = make_list(m);
+            double t0 = now();
+            optimize_renderlist(list);
+            double t = now() - t0;
+            if(best<0. || t<best) best = t;
+            after = renderlist_acmr(list->indices, list->ilen, list->len);
+            if(m->mode_init==GL_QUADS && !quads_kept(list))
+                broken = 1;
+            free_list(list);
+        }
+        if(after>before+0.001f || broken)
+            ++worse;
+        printf("%-16s %10d %10d %10.3f %10.3f %10.1f%s\n", m->name, m->ilen/3, m->len, before, after, best, broken?" (quads split)":"");
+        free(m->indices);
+    }
+    return worse?1:0;
+}